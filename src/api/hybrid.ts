@@ -4,8 +4,10 @@ import {Bounds} from "photoshop/dom/types/SharedTypes";
 import {notify} from "./photoshop";
 import {truncatePath} from "../util";
 import {Layers} from "photoshop/dom/collections/Layers";
+import {Layer} from "photoshop/dom/Layer";
 
 const _PixelFormat: Record<string, number> = {
+  'Auto': -1,
   'DXT5': 2,
   'DXT3': 1,
   'DXT1': 0,
@@ -39,8 +41,39 @@ interface ImageToTexConversionOptions {
   mipmapFilter?: number;
   generateMipmaps?: boolean;
   preMultiplyAlpha?: boolean;
+  skipUnchanged?: boolean;
+  targetPsnr?: number;
+  tiledExport?: boolean;
+  tileBudget?: number;
+  concurrency?: number;
+  targets?: { pixelFormat: number, suffix: string }[];
+  // Opt-in store of encoded textures shared across documents, see TextureStore.hpp
+  sharedCache?: boolean;
+  sharedCacheFolder?: string;
+  sharedCacheMaxBytes?: number;
   exportAtlas?: boolean;
   grid?: { w: number; h: number };
+  // Number of additional half resolution exports, e.g. 2 for @0.5x and @0.25x
+  scaledVariants?: number;
+  padToPowerOfTwo?: boolean;
+  // Also write the binary `.atlas` sidecar next to the XML atlas, on by default
+  binaryAtlas?: boolean;
+  // Adds a perfect hash over element names to the binary atlas, for constant time lookups by name
+  atlasNameIndex?: boolean;
+  // Lays the layers out automatically instead of using their position in the document
+  packAtlas?: PackAtlasOptions;
+}
+
+interface PackAtlasOptions {
+  padding?: number;
+  blockAlign?: number;
+  powerOfTwo?: boolean;
+}
+
+interface PackAtlasResult {
+  width: number;
+  height: number;
+  elements: { id: number, name: string, left: number, top: number, x: number, y: number, w: number, h: number }[];
 }
 
 interface ImageData {
@@ -49,37 +82,156 @@ interface ImageData {
   data: ArrayBufferLike;
 }
 
+type TexStream = { readonly __brand: "TexStream" };
+type ExportQueue = { readonly __brand: "ExportQueue" };
+
+// One entry per written texture and its atlas, the 1x layout first
+interface ExportTexAndAtlasResult {
+  texPaths: string[];
+  atlasPaths: string[];
+  message: string;
+  timings: { parseMs: number, atlasMs: number, encodeMs: number, totalMs: number };
+}
+
+interface ExportTexBatchItem {
+  name: string;
+  message: string;
+  queuedMs: number;
+  encodeMs: number;
+}
+
+interface ExportTexBatchResult {
+  name: string;
+  message?: string;
+  error?: string;
+  // Set when the texture was exported but the atlas wasn't
+  atlasError?: string;
+  fetchMs: number;
+  queuedMs?: number;
+  encodeMs?: number;
+}
+
 interface ExtendedDocument {
   name: string,
   width: number,
   height: number,
   layers: Layers,
   grid?: { w: number, h: number };
+  scaledVariants?: number;
+  padToPowerOfTwo?: boolean;
+  binaryAtlas?: boolean;
+  atlasNameIndex?: boolean;
+  // Suffix of each target texture, every layout gets one atlas per suffix
+  textureSuffixes?: string[];
+  layerSnapshot?: LayerSnapshot;
+}
+
+// Leaf layers read with one batchPlay call. `bounds` holds id, left, top, right, bottom for each name.
+interface LayerSnapshot {
+  names: string[];
+  bounds: ArrayBuffer;
+}
+
+interface ImportTexResult {
+  name: string,
+  w: number,
+  h: number,
+  buffer?: Uint8Array,
+  buffers?: {
+    name: string, buffer: Uint8Array,
+    w: number, h: number,
+    left: number, right: number,
+    bottom: number, top: number
+  }[]
 }
 
 interface HybridModule {
   exportTex: (doc: ExtendedDocument, outputFolder: string, data: ImageData, options: ImageToTexConversionOptions) => string;
+  exportTexAsync: (doc: ExtendedDocument, outputFolder: string, data: ImageData, options: ImageToTexConversionOptions) => Promise<string>;
+  exportTexAndAtlas: (doc: ExtendedDocument, outputFolder: string, data: ImageData, options: ImageToTexConversionOptions) => Promise<ExportTexAndAtlasResult>;
+  textureStoreStats: (folder?: string) => { hits: number, misses: number, entries: number, bytes: number };
+  exportTexToBuffer: (data: ImageData, options: ImageToTexConversionOptions) => Promise<ArrayBuffer>;
+  beginTexStream: (doc: ExtendedDocument, outputFolder: string, image: { size: { w: number, h: number } }, options: ImageToTexConversionOptions) => TexStream;
+  writeTexTile: (stream: TexStream, left: number, top: number, tile: ImageData) => void;
+  finishTexStream: (stream: TexStream) => Promise<string>;
+  createExportQueue: (options: { concurrency?: number }) => { queue: ExportQueue, concurrency: number };
+  enqueueTexExport: (queue: ExportQueue, doc: ExtendedDocument, outputFolder: string, data: ImageData, options: ImageToTexConversionOptions) => Promise<ExportTexBatchItem>;
   exportAtlas: (doc: ExtendedDocument, outputPath: string) => string;
-  importTex: (texPath: string, atlasPath?: string) => {
-    name: string,
-    w: number,
-    h: number,
-    buffer?: Uint8Array,
-    buffers?: {
-      name: string, buffer: Uint8Array,
-      w: number, h: number,
-      left: number, right: number,
-      bottom: number, top: number
-    }[]
-  };
+  packAtlas: (doc: ExtendedDocument, options: PackAtlasOptions) => PackAtlasResult;
+  importTex: (texPath: string, atlasPath?: string) => ImportTexResult;
+  importTexAsync: (texPath: string, atlasPath?: string) => Promise<ImportTexResult>;
 }
 
 const hybridModule = require("bolt-uxp-hybrid.uxpaddon") as Promise<HybridModule>;
 
-const exportAtlasTask = async (doc: Document, outputFolder: string, grid?: { w: number, h: number }) => {
+// Attaches the export options the native side reads from the document
+const extendDocument = (doc: Document, options: ImageToTexConversionOptions) => {
+  const extendedDoc: ExtendedDocument = doc;
+  extendedDoc.grid = options.grid ?? undefined;
+  extendedDoc.scaledVariants = options.scaledVariants;
+  extendedDoc.padToPowerOfTwo = options.padToPowerOfTwo;
+  extendedDoc.binaryAtlas = options.binaryAtlas;
+  extendedDoc.atlasNameIndex = options.atlasNameIndex;
+  extendedDoc.textureSuffixes = options.targets?.map((target) => target.suffix);
+  return extendedDoc;
+};
+
+type LayerDescriptor = {
+  name: string,
+  layerID: number,
+  layerSection?: { _value: string },
+  background?: boolean,
+  bounds: Record<"left" | "top" | "right" | "bottom", { _value: number }>,
+};
+
+// Fetches the name and bounds of every leaf layer with a single descriptor, instead of one DOM lookup per
+// property per layer on the native side. Returns undefined when the descriptor can't be read.
+// Layers come in the order Document::iterateLayers walks the DOM: top-level layers top-down, then the
+// contents of each group level by level. `skipBackground` leaves the Background layer out.
+const snapshotLayers = async (doc: Document, skipBackground = false): Promise<LayerSnapshot | undefined> => {
+  const documentRef = {_ref: "document", _id: doc.id};
+  const [background] = await photoshop.action.batchPlay([{
+    _obj: "get",
+    _target: [{_property: "hasBackgroundLayer"}, documentRef],
+  }], {});
+  // Layer indices are bottom-up and start at the background layer, which is index 0 when there is one
+  const [result] = await photoshop.action.batchPlay([{
+    _obj: "multiGet",
+    _target: {_ref: [documentRef]},
+    extendedReference: [["name", "layerID", "bounds", "layerSection", "background"], {_obj: "layer", index: background?.hasBackgroundLayer ? 0 : 1, count: -1}],
+    options: {failOnMissingProperty: false, failOnMissingElement: false},
+  }], {});
+  if (!Array.isArray(result?.list)) {
+    return undefined;
+  }
+
+  // Top-down, a group's start comes before its contents and its end after them
+  let depth = 0;
+  const leaves: { layer: LayerDescriptor, depth: number }[] = [];
+  for (const layer of (result.list as LayerDescriptor[]).slice().reverse()) {
+    const section = layer.layerSection?._value ?? "layerSectionContent";
+    if (section === "layerSectionStart") {
+      depth++;
+    } else if (section === "layerSectionEnd") {
+      depth--;
+    } else if (layer.bounds && !(skipBackground && layer.background)) {
+      leaves.push({layer, depth});
+    }
+  }
+  // A stable sort by depth turns the depth-first panel order into the DOM walk's level order
+  const layers = leaves.sort((a, b) => a.depth - b.depth).map(({layer}) => layer);
+
+  const bounds = new Float64Array(layers.length * 5);
+  layers.forEach((layer, i) => {
+    bounds.set([layer.layerID, layer.bounds.left._value, layer.bounds.top._value, layer.bounds.right._value, layer.bounds.bottom._value], i * 5);
+  });
+  return {names: layers.map((layer) => layer.name), bounds: bounds.buffer};
+};
+
+const exportAtlasTask = async (doc: Document, outputFolder: string, options: ImageToTexConversionOptions) => {
   try {
-    const extendedDoc: ExtendedDocument = doc;
-    extendedDoc.grid = grid;
+    const extendedDoc = extendDocument(doc, options);
+    extendedDoc.layerSnapshot = await snapshotLayers(doc);
     return (await hybridModule).exportAtlas(extendedDoc, outputFolder);
   } catch (err) {
     throw new Error("Export Atlas command failed. \n" + (err as Error).message);
@@ -94,34 +246,233 @@ const exportTexTask = async (doc: Document, outputFolder: string, options: Image
       data: (await psImageData.getData({})).buffer,
     };
 
-    let exportTexResult = (await hybridModule).exportTex(doc, outputFolder, imageData, options);
+    // The native side copies the pixels before returning, so Photoshop's buffer can be released while encoding
+    const exportTexResult = (await hybridModule).exportTexAsync(extendDocument(doc, options), outputFolder, imageData, options);
 
     await psImageData.dispose();
 
-    return exportTexResult;
+    return await exportTexResult;
   } catch (err) {
     throw new Error("Export Tex command failed. \n" + (err as Error).message);
   }
 };
 
+// Encodes the document and returns the .tex file's bytes without writing anything to disk
+const exportTexToBuffer = async (doc: Document, options: ImageToTexConversionOptions) => {
+  return await photoshop.core.executeAsModal(async () => {
+    const psImageData = (await photoshop.imaging.getPixels({documentID: doc.id})).imageData;
+    const imageData = {
+      size: {w: doc.width, h: doc.height},
+      channels: psImageData.components,
+      data: (await psImageData.getData({})).buffer,
+    };
+
+    const encoded = (await hybridModule).exportTexToBuffer(imageData, options);
+
+    await psImageData.dispose();
+
+    return await encoded;
+  }, {commandName: "exportTexToBuffer"});
+};
+
+// Exports the texture and the atlas with a single native call, so the document is only read once
+const exportTexAndAtlasTask = async (doc: Document, outputFolder: string, options: ImageToTexConversionOptions) => {
+  try {
+    const extendedDoc = extendDocument(doc, options);
+    extendedDoc.layerSnapshot = await snapshotLayers(doc);
+
+    const psImageData = (await photoshop.imaging.getPixels({documentID: doc.id})).imageData;
+    const imageData = {
+      size: {w: doc.width, h: doc.height},
+      channels: psImageData.components,
+      data: (await psImageData.getData({})).buffer,
+    };
+
+    const result = (await hybridModule).exportTexAndAtlas(extendedDoc, outputFolder, imageData, options);
+
+    await psImageData.dispose();
+
+    return await result;
+  } catch (err) {
+    throw new Error("Export command failed. \n" + (err as Error).message);
+  }
+};
+
+const DEFAULT_TILE_BUDGET = 64 * 1024 * 1024;
+
+// Fetches the document in horizontal bands of at most `options.tileBudget` bytes and streams them to the
+// native side, so the whole document never has to be held in one JS buffer.
+const exportTexTiledTask = async (doc: Document, outputFolder: string, options: ImageToTexConversionOptions) => {
+  try {
+    const module = await hybridModule;
+    const rowsPerTile = Math.max(1, Math.floor((options.tileBudget ?? DEFAULT_TILE_BUDGET) / (doc.width * 4)));
+    let stream: TexStream | undefined;
+
+    for (let top = 0; top < doc.height; top += rowsPerTile) {
+      const bottom = Math.min(doc.height, top + rowsPerTile);
+      const {imageData: psImageData, sourceBounds} = await photoshop.imaging.getPixels({
+        documentID: doc.id,
+        sourceBounds: {left: 0, top, right: doc.width, bottom},
+      });
+      const tile = {
+        size: {w: sourceBounds.right - sourceBounds.left, h: sourceBounds.bottom - sourceBounds.top},
+        channels: psImageData.components,
+        data: (await psImageData.getData({})).buffer,
+      };
+
+      stream ??= module.beginTexStream(extendDocument(doc, options), outputFolder, {size: {w: doc.width, h: doc.height}}, options);
+      module.writeTexTile(stream, sourceBounds.left, sourceBounds.top, tile);
+
+      await psImageData.dispose();
+    }
+
+    return await module.finishTexStream(stream!);
+  } catch (err) {
+    throw new Error("Export Tex command failed. \n" + (err as Error).message);
+  }
+};
+
+const flattenLayers = (layers: Layers): Layer[] =>
+  [...layers].flatMap((layer) => layer.layers ? flattenLayers(layer.layers) : [layer]);
+
+// Duplicates `doc` with every layer moved to the layout computed by the native packer. The caller closes it.
+// The Background layer can't move and covers the whole canvas, so it stays where it is and isn't packed.
+const packDocument = async (doc: Document, options: PackAtlasOptions) => {
+  const extendedDoc: ExtendedDocument = doc;
+  // The DOM walk can't tell the Background layer apart, so packing needs the snapshot
+  extendedDoc.layerSnapshot = await snapshotLayers(doc, true);
+  if (!extendedDoc.layerSnapshot) {
+    throw new Error(`Could not read the layers of ${doc.name} to pack them.`);
+  }
+  const layout = (await hybridModule).packAtlas(extendedDoc, options);
+  const packed = await doc.duplicate(doc.name);
+  try {
+    const layers = new Map(flattenLayers(packed.layers).map((layer) => [layer.id, layer]));
+    for (const element of layout.elements) {
+      const layer = layers.get(element.id);
+      if (!layer) {
+        throw new Error(`Layer ${element.name} (id ${element.id}) is missing from the copy of ${doc.name}.`);
+      }
+      await layer.translate(element.x - element.left, element.y - element.top);
+    }
+    await packed.resizeCanvas(layout.width, layout.height, photoshop.constants.AnchorPosition.TOPLEFT);
+  } catch (err) {
+    await packed.closeWithoutSaving();
+    throw err;
+  }
+  return packed;
+};
+
 const exportTex = async (doc: Document, outputFolder: string, options: ImageToTexConversionOptions) => {
   const texFilePath = truncatePath(`${outputFolder}\\${doc.name.replace(".psd", ".tex")}`, 50);
   const atlasFilePath = truncatePath(`${outputFolder}\\${doc.name.replace(".psd", ".xml")}`, 50);
 
   return await photoshop.core.executeAsModal(async (ctx) => {
-    ctx.reportProgress({commandName: `Exporting ${texFilePath}...`, value: 0.001});
-    await exportTexTask(doc, outputFolder, options);
+    // Packing works on a copy so the artist's document is left untouched. Packed rects are already aligned.
+    if (options.packAtlas) {
+      ctx.reportProgress({commandName: `Packing ${doc.name}...`, value: 0.001});
+    }
+    const target = options.packAtlas ? await packDocument(doc, options.packAtlas) : doc;
+    const targetOptions = options.packAtlas ? {...options, grid: undefined} : options;
+
+    try {
+      if (options.exportAtlas && !options.tiledExport) {
+        ctx.reportProgress({commandName: `Exporting ${texFilePath} and ${atlasFilePath}...`, value: 0.001});
+        await exportTexAndAtlasTask(target, outputFolder, targetOptions);
+        ctx.reportProgress({commandName: "Done.", value: 1});
+        await new Promise((resolve) => window.setTimeout(resolve, 500));
+        return;
+      }
+
+      ctx.reportProgress({commandName: `Exporting ${texFilePath}...`, value: 0.001});
+      await (options.tiledExport ? exportTexTiledTask : exportTexTask)(target, outputFolder, targetOptions);
 
-    if (options.exportAtlas) {
-      ctx.reportProgress({commandName: `Exporting ${atlasFilePath}...`, value: 0.5});
-      await exportAtlasTask(doc, outputFolder, options.grid ?? undefined);
+      if (options.exportAtlas) {
+        ctx.reportProgress({commandName: `Exporting ${atlasFilePath}...`, value: 0.5});
+        await exportAtlasTask(target, outputFolder, targetOptions);
+      }
+      ctx.reportProgress({commandName: "Done.", value: 1});
+      await new Promise((resolve) => window.setTimeout(resolve, 500));
+    } finally {
+      if (target !== doc) {
+        await target.closeWithoutSaving();
+      }
     }
-    ctx.reportProgress({commandName: "Done.", value: 1});
-    await new Promise((resolve) => window.setTimeout(resolve, 500));
   }, {commandName: "exportTex"});
 
 };
 
+// Exports every document through one native queue. Pixels of the next document are fetched while the
+// previous ones encode, with at most `concurrency` documents waiting on the native side.
+// Documents are exported as they are, packing and tiled fetches are only available for single exports.
+const exportTexBatch = async (docs: Document[], outputFolder: string, options: ImageToTexConversionOptions) => {
+  if (options.packAtlas || options.tiledExport) {
+    throw new Error("Batch export can't pack layers or fetch pixels in tiles, export documents one at a time instead.");
+  }
+  return await photoshop.core.executeAsModal(async (ctx) => {
+    const module = await hybridModule;
+    const {queue, concurrency} = module.createExportQueue({concurrency: options.concurrency});
+    const results: ExportTexBatchResult[] = [];
+    const pending = new Set<Promise<void>>();
+    let done = 0;
+
+    const onDone = (result: ExportTexBatchResult) => {
+      results.push(result);
+      ctx.reportProgress({commandName: `Exported ${result.name} (${++done}/${docs.length})`, value: done / docs.length});
+    };
+
+    for (const doc of docs) {
+      ctx.reportProgress({commandName: `Reading ${doc.name}...`, value: Math.max(0.001, done / docs.length)});
+      const fetchStart = Date.now();
+      let fetchMs = 0;
+      let texture: Promise<ExportTexBatchItem> | undefined;
+      try {
+        const psImageData = (await photoshop.imaging.getPixels({documentID: doc.id})).imageData;
+        try {
+          const imageData = {
+            size: {w: doc.width, h: doc.height},
+            channels: psImageData.components,
+            data: (await psImageData.getData({})).buffer,
+          };
+          fetchMs = Date.now() - fetchStart;
+          texture = module.enqueueTexExport(queue, extendDocument(doc, options), outputFolder, imageData, options);
+        } finally {
+          await psImageData.dispose();
+        }
+      } catch (err) {
+        // Once queued, the export is reported with its own result below, even if releasing the pixels failed
+        if (!texture) {
+          onDone({name: doc.name, error: (err as Error).message, fetchMs: Date.now() - fetchStart});
+          continue;
+        }
+      }
+
+      // The atlas is reported with the document's result, so every document is reported exactly once
+      const atlas: Promise<string | undefined> = options.exportAtlas
+        ? exportAtlasTask(doc, outputFolder, options).then(() => undefined, (err) => (err as Error).message)
+        : Promise.resolve(undefined);
+      const item = Promise.all([
+        texture.then(
+          (result): ExportTexBatchResult => ({...result, fetchMs}),
+          (err): ExportTexBatchResult => ({name: doc.name, error: (err as Error).message, fetchMs}),
+        ),
+        atlas,
+      ]).then(([result, atlasError]) => onDone({...result, atlasError}));
+
+      pending.add(item);
+      item.finally(() => pending.delete(item));
+      await atlas;
+      if (pending.size >= concurrency) {
+        await Promise.race(pending);
+      }
+    }
+
+    await Promise.all(pending);
+    ctx.reportProgress({commandName: "Done.", value: 1});
+    return results;
+  }, {commandName: "exportTexBatch"});
+};
+
 const importTex = async (texPath: string, atlasPath?: string) => {
   async function createLayer(doc: Document, name: string, width: number, height: number, buffer: Uint8Array, bounds?: Bounds) {
     const layer = await doc.createPixelLayer({name});
@@ -146,7 +497,7 @@ const importTex = async (texPath: string, atlasPath?: string) => {
 
   await photoshop.core.executeAsModal(async (ctx) => {
     ctx.reportProgress({commandName: `Reading file${atlasPath ? "s" : ""}`, value: 0.001});
-    const imageData = (await hybridModule).importTex(texPath, atlasPath);
+    const imageData = await (await hybridModule).importTexAsync(texPath, atlasPath);
     const progressStep = imageData.buffer ? 1 / 4 : 1 / (3 + imageData.buffers!.length);
     let progress = progressStep;
 
@@ -184,8 +535,12 @@ export {
   MipmapFilter,
 }
 
+export type {ExportTexBatchResult};
+
 export default {
   exportTex,
+  exportTexBatch,
+  exportTexToBuffer,
   // exportAtlas,
   importTex
 }
\ No newline at end of file
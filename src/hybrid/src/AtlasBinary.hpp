@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "AtlasIndex.hpp"
+
+/*
+ * Binary atlas sidecar, written next to the XML atlas as `{name}.atlas`.
+ * Every section is at a fixed or header-given offset and naturally aligned, so a reader can map the
+ * file and use it in place without parsing:
+ *
+ *   Header                       40 bytes (32 in version 1)
+ *   NameEntry[element_count]     offset and length of each element name in the string table
+ *   UvRecord[element_count]      {u1, u2, v1, v2} as floats, same order as the names
+ *   string table                 texture name followed by the element names, not null terminated
+ *   name index                   optional minimal perfect hash over the names, see AtlasIndex.hpp
+ *
+ * Multi-byte values are little endian.
+ */
+namespace AtlasBinary
+{
+  inline constexpr char kMagic[4] = {'T', 'X', 'A', 'T'};
+  inline constexpr uint32_t kVersion = 2;
+  inline constexpr size_t kVersion1HeaderSize = 32;
+
+  struct Header {
+    char magic[4] = {kMagic[0], kMagic[1], kMagic[2], kMagic[3]};
+    uint32_t version = kVersion;
+    uint32_t element_count = 0;
+    uint32_t names_offset = 0;
+    uint32_t records_offset = 0;
+    uint32_t strings_offset = 0;
+    uint32_t strings_size = 0;
+    // Length of the texture name at the start of the string table
+    uint32_t texture_name_length = 0;
+    // Added in version 2, both 0 when the atlas has no name index
+    uint32_t index_offset = 0;
+    uint32_t index_size = 0;
+  };
+  static_assert(sizeof(Header) == 40);
+
+  struct NameEntry {
+    uint32_t offset = 0, length = 0;
+  };
+
+  struct UvRecord {
+    float u1 = 0, u2 = 0, v1 = 0, v2 = 0;
+  };
+
+  class Writer {
+  public:
+    // `name_index` adds a perfect hash over the element names, for constant time lookups with View::find
+    explicit Writer(std::string_view texture_name, bool name_index = false)
+    : strings_(texture_name), name_index_(name_index) {}
+
+    void add(std::string_view name, double u1, double u2, double v1, double v2) {
+      names_.push_back({static_cast<uint32_t>(strings_.size()), static_cast<uint32_t>(name.size())});
+      records_.push_back({static_cast<float>(u1), static_cast<float>(u2), static_cast<float>(v1), static_cast<float>(v2)});
+      strings_ += name;
+    }
+
+    [[nodiscard]] std::vector<uint8_t> serialize() const;
+
+  private:
+    [[nodiscard]] std::vector<uint8_t> serializeWith(const std::vector<uint32_t>& index) const {
+      Header header;
+      header.element_count = static_cast<uint32_t>(names_.size());
+      header.names_offset = sizeof(Header);
+      header.records_offset = header.names_offset + static_cast<uint32_t>(names_.size() * sizeof(NameEntry));
+      header.strings_offset = header.records_offset + static_cast<uint32_t>(records_.size() * sizeof(UvRecord));
+      header.strings_size = static_cast<uint32_t>(strings_.size());
+      header.texture_name_length = texture_name_length_;
+
+      if (!index.empty()) {
+        header.index_offset = (header.strings_offset + header.strings_size + 3) / 4 * 4;
+        header.index_size = static_cast<uint32_t>(index.size() * sizeof(uint32_t));
+      }
+
+      std::vector<uint8_t> bytes(index.empty() ? header.strings_offset + strings_.size() : header.index_offset + header.index_size);
+      std::memcpy(bytes.data(), &header, sizeof(header));
+      std::memcpy(bytes.data() + header.names_offset, names_.data(), names_.size() * sizeof(NameEntry));
+      std::memcpy(bytes.data() + header.records_offset, records_.data(), records_.size() * sizeof(UvRecord));
+      std::memcpy(bytes.data() + header.strings_offset, strings_.data(), strings_.size());
+      if (!index.empty()) {
+        std::memcpy(bytes.data() + header.index_offset, index.data(), header.index_size);
+      }
+      return bytes;
+    }
+
+    // Repeated names can't be told apart by name, lookups find the first element using one
+    [[nodiscard]] std::vector<uint32_t> buildIndex() const {
+      std::vector<std::string_view> names;
+      std::vector<uint32_t> element_indices;
+      std::unordered_set<std::string_view> seen;
+      for (uint32_t i = 0; i < names_.size(); i++) {
+        const std::string_view name(strings_.data() + names_[i].offset, names_[i].length);
+        if (seen.insert(name).second) {
+          names.push_back(name);
+          element_indices.push_back(i);
+        }
+      }
+      return AtlasIndex::build(names, element_indices);
+    }
+
+    std::string strings_;
+    uint32_t texture_name_length_ = static_cast<uint32_t>(strings_.size());
+    bool name_index_;
+    std::vector<NameEntry> names_;
+    std::vector<UvRecord> records_;
+  };
+
+  // Read-only view over the bytes of a sidecar, e.g. a mapped file. The bytes must outlive the view.
+  class View {
+  public:
+    static bool isAtlas(std::span<const uint8_t> bytes) {
+      return bytes.size() >= kVersion1HeaderSize && std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) == 0;
+    }
+
+    explicit View(std::span<const uint8_t> bytes) : bytes_(bytes) {
+      if (!isAtlas(bytes)) {
+        throw std::runtime_error("Not a binary atlas");
+      }
+      std::memcpy(static_cast<void*>(&header_), bytes.data(), kVersion1HeaderSize);
+      if (header_.version != 1 && header_.version != kVersion) {
+        throw std::runtime_error("Unsupported binary atlas version " + std::to_string(header_.version));
+      }
+      if (header_.version >= 2) {
+        if (bytes.size() < sizeof(Header)) {
+          throw std::runtime_error("Binary atlas is truncated or corrupted");
+        }
+        std::memcpy(&header_, bytes.data(), sizeof(header_));
+      }
+
+      const uint64_t count = header_.element_count;
+      if (header_.names_offset % alignof(NameEntry) != 0 || header_.records_offset % alignof(UvRecord) != 0 ||
+          header_.names_offset + count * sizeof(NameEntry) > bytes.size() ||
+          header_.records_offset + count * sizeof(UvRecord) > bytes.size() ||
+          uint64_t{header_.strings_offset} + header_.strings_size > bytes.size() ||
+          header_.texture_name_length > header_.strings_size) {
+        throw std::runtime_error("Binary atlas is truncated or corrupted");
+      }
+      for (const auto& entry : names()) {
+        if (uint64_t{entry.offset} + entry.length > header_.strings_size) {
+          throw std::runtime_error("Binary atlas is truncated or corrupted");
+        }
+      }
+
+      if (header_.index_size > 0) {
+        if (header_.index_offset % alignof(uint32_t) != 0 || uint64_t{header_.index_offset} + header_.index_size > bytes.size()) {
+          throw std::runtime_error("Binary atlas is truncated or corrupted");
+        }
+        index_ = AtlasIndex::View(bytes.subspan(header_.index_offset, header_.index_size));
+      }
+    }
+
+    [[nodiscard]] bool hasIndex() const { return !index_.empty(); }
+
+    // Index of the first element called `name`. Constant time with a name index, a scan otherwise.
+    [[nodiscard]] std::optional<size_t> find(std::string_view name) const {
+      if (hasIndex()) {
+        const auto candidate = index_.candidate(name);
+        if (candidate.has_value() && *candidate < size() && this->name(*candidate) == name) {
+          return *candidate;
+        }
+        return std::nullopt;
+      }
+      for (size_t i = 0; i < size(); i++) {
+        if (this->name(i) == name) {
+          return i;
+        }
+      }
+      return std::nullopt;
+    }
+
+    [[nodiscard]] size_t size() const { return header_.element_count; }
+
+    [[nodiscard]] std::string_view textureName() const { return string(0, header_.texture_name_length); }
+
+    [[nodiscard]] std::string_view name(size_t index) const {
+      const auto& entry = names()[index];
+      return string(entry.offset, entry.length);
+    }
+
+    [[nodiscard]] const UvRecord& uv(size_t index) const { return records()[index]; }
+
+  private:
+    [[nodiscard]] std::span<const NameEntry> names() const {
+      return {reinterpret_cast<const NameEntry*>(bytes_.data() + header_.names_offset), header_.element_count};
+    }
+
+    [[nodiscard]] std::span<const UvRecord> records() const {
+      return {reinterpret_cast<const UvRecord*>(bytes_.data() + header_.records_offset), header_.element_count};
+    }
+
+    [[nodiscard]] std::string_view string(uint32_t offset, uint32_t length) const {
+      return {reinterpret_cast<const char*>(bytes_.data() + header_.strings_offset + offset), length};
+    }
+
+    std::span<const uint8_t> bytes_;
+    Header header_;
+    AtlasIndex::View index_;
+  };
+
+  // Debug check of a serialized index: every name is found, and a name longer than all of them isn't
+  inline bool indexFindsEveryName(std::span<const uint8_t> bytes) {
+    const View view(bytes);
+    size_t longest = 0;
+    for (size_t i = 0; i < view.size(); i++) {
+      if (!view.find(view.name(i)).has_value()) {
+        return false;
+      }
+      longest = std::max(longest, view.name(i).size());
+    }
+    return !view.find(std::string(longest + 1, '?')).has_value();
+  }
+
+  inline std::vector<uint8_t> Writer::serialize() const {
+    const auto index = name_index_ && !names_.empty() ? buildIndex() : std::vector<uint32_t>{};
+    auto bytes = serializeWith(index);
+    assert(index.empty() || indexFindsEveryName(bytes));
+    return bytes;
+  }
+}
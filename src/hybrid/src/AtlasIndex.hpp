@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "Hash.hpp"
+
+/*
+ * Minimal perfect hash over atlas element names (hash and displace).
+ * Names are spread over buckets of ~4 names. Each bucket stores the displacement that sends all of its
+ * names to distinct free slots of a table with exactly one slot per name, and each slot stores the
+ * index of its element. A lookup is one hash, two array reads and one name comparison, with no hash
+ * map to build at load time.
+ *
+ * Layout, little endian uint32 values:
+ *   seed, bucket_count, slot_count, reserved
+ *   displacements[bucket_count]
+ *   slots[slot_count]
+ */
+namespace AtlasIndex
+{
+  struct Header {
+    uint32_t seed = 0;
+    uint32_t bucket_count = 0;
+    uint32_t slot_count = 0;
+    uint32_t reserved = 0;
+  };
+
+  inline uint64_t hashName(std::string_view name, uint32_t seed) {
+    return Hasher(seed).update(name.data(), name.size()).digest();
+  }
+
+  // Bucket of a name hash
+  inline uint32_t bucketOf(uint64_t hash, uint32_t bucket_count) {
+    return static_cast<uint32_t>((hash >> 32) % bucket_count);
+  }
+
+  // Slot of a name hash once its bucket's displacement is applied (splitmix64 finalizer)
+  inline uint32_t slotOf(uint64_t hash, uint32_t displacement, uint32_t slot_count) {
+    uint64_t x = hash ^ (displacement * 0x9E3779B97F4A7C15ull);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return static_cast<uint32_t>(x % slot_count);
+  }
+
+  // Builds the index of `names`. Names must be unique, only the first element of a repeated name can be
+  // indexed, so callers drop repeats and point `element_indices` at the elements that are kept.
+  // Returns an empty index if no seed works within the limits, the atlas is then written without one.
+  inline std::vector<uint32_t> build(std::span<const std::string_view> names, std::span<const uint32_t> element_indices) {
+    constexpr uint32_t kMaxSeeds = 16;
+    constexpr uint32_t kMaxDisplacement = 1u << 24;
+    const auto slot_count = static_cast<uint32_t>(names.size());
+    const auto bucket_count = std::max<uint32_t>(1, (slot_count + 3) / 4);
+
+    for (uint32_t seed = 0; seed < kMaxSeeds; seed++) {
+      std::vector<uint64_t> hashes(names.size());
+      std::vector<std::vector<uint32_t>> buckets(bucket_count);
+      for (uint32_t i = 0; i < slot_count; i++) {
+        hashes[i] = hashName(names[i], seed);
+        buckets[bucketOf(hashes[i], bucket_count)].push_back(i);
+      }
+
+      // Fullest buckets first, while most slots are still free
+      std::vector<uint32_t> order(bucket_count);
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+      std::vector<uint32_t> index(4 + bucket_count + slot_count, 0);
+      uint32_t* displacements = index.data() + 4;
+      uint32_t* slots = displacements + bucket_count;
+      std::vector<bool> taken(slot_count, false);
+      std::vector<uint32_t> placed;
+
+      bool failed = false;
+      for (uint32_t bucket : order) {
+        if (buckets[bucket].empty()) {
+          break;
+        }
+        uint32_t displacement = 0;
+        for (; displacement < kMaxDisplacement; displacement++) {
+          placed.clear();
+          for (uint32_t name : buckets[bucket]) {
+            const uint32_t slot = slotOf(hashes[name], displacement, slot_count);
+            if (taken[slot] || std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+              break;
+            }
+            placed.push_back(slot);
+          }
+          if (placed.size() == buckets[bucket].size()) {
+            break;
+          }
+        }
+        if (displacement == kMaxDisplacement) {
+          failed = true;
+          break;
+        }
+
+        displacements[bucket] = displacement;
+        for (size_t i = 0; i < placed.size(); i++) {
+          taken[placed[i]] = true;
+          slots[placed[i]] = element_indices[buckets[bucket][i]];
+        }
+      }
+      if (failed) {
+        continue;
+      }
+
+      index[0] = seed;
+      index[1] = bucket_count;
+      index[2] = slot_count;
+      return index;
+    }
+    return {};
+  }
+
+  // Read-only view over an index section. The bytes must outlive the view.
+  class View {
+  public:
+    View() = default;
+
+    explicit View(std::span<const uint8_t> bytes) {
+      if (bytes.size() < sizeof(Header)) {
+        throw std::runtime_error("Atlas index is truncated");
+      }
+      std::memcpy(&header_, bytes.data(), sizeof(header_));
+      if (header_.bucket_count == 0 || header_.slot_count == 0 ||
+          sizeof(Header) + (uint64_t{header_.bucket_count} + header_.slot_count) * sizeof(uint32_t) > bytes.size()) {
+        throw std::runtime_error("Atlas index is truncated");
+      }
+      displacements_ = reinterpret_cast<const uint32_t*>(bytes.data() + sizeof(Header));
+      slots_ = displacements_ + header_.bucket_count;
+    }
+
+    [[nodiscard]] bool empty() const { return slots_ == nullptr; }
+
+    // The only element `name` can be. The caller still compares names, as names that aren't in the atlas
+    // land on some slot too.
+    [[nodiscard]] std::optional<uint32_t> candidate(std::string_view name) const {
+      if (empty()) {
+        return std::nullopt;
+      }
+      const uint64_t hash = hashName(name, header_.seed);
+      const uint32_t displacement = displacements_[bucketOf(hash, header_.bucket_count)];
+      return slots_[slotOf(hash, displacement, header_.slot_count)];
+    }
+
+  private:
+    Header header_;
+    const uint32_t* displacements_ = nullptr;
+    const uint32_t* slots_ = nullptr;
+  };
+}
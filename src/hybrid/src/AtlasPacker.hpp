@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+/*
+ * MaxRects bin packer (best short side fit) used to lay atlas elements out automatically.
+ * Every rectangle is grown by `padding` and rounded up to `block_align`, so elements start on block
+ * boundaries and compressed blocks never mix two elements. Rectangles are never rotated, layers are
+ * composited as they are.
+ */
+namespace AtlasPacker
+{
+  struct Rect {
+    size_t x = 0, y = 0;
+    size_t w = 0, h = 0;
+
+    [[nodiscard]] size_t right() const { return x + w; }
+    [[nodiscard]] size_t bottom() const { return y + h; }
+
+    [[nodiscard]] bool contains(const Rect& other) const {
+      return other.x >= x && other.y >= y && other.right() <= right() && other.bottom() <= bottom();
+    }
+
+    [[nodiscard]] bool intersects(const Rect& other) const {
+      return other.x < right() && x < other.right() && other.y < bottom() && y < other.bottom();
+    }
+  };
+
+  struct Options {
+    size_t padding = 0;
+    size_t block_align = 1;
+    bool power_of_two = false;
+  };
+
+  struct Result {
+    size_t width = 0, height = 0;
+    // Position of each input size, in input order
+    std::vector<Rect> rects;
+  };
+
+  class MaxRectsBin {
+  public:
+    MaxRectsBin(size_t width, size_t height) : free_{{0, 0, width, height}} {}
+
+    std::optional<Rect> insert(size_t w, size_t h) {
+      std::optional<Rect> best;
+      size_t best_short = std::numeric_limits<size_t>::max(), best_long = std::numeric_limits<size_t>::max();
+      for (const auto& free : free_) {
+        if (free.w < w || free.h < h) {
+          continue;
+        }
+        const size_t leftover_w = free.w - w, leftover_h = free.h - h;
+        const size_t short_side = std::min(leftover_w, leftover_h), long_side = std::max(leftover_w, leftover_h);
+        if (short_side < best_short || (short_side == best_short && long_side < best_long)) {
+          best = Rect{free.x, free.y, w, h};
+          best_short = short_side;
+          best_long = long_side;
+        }
+      }
+      if (best.has_value()) {
+        place(*best);
+      }
+      return best;
+    }
+
+  private:
+    void place(const Rect& used) {
+      std::vector<Rect> next;
+      next.reserve(free_.size() + 4);
+      for (const auto& free : free_) {
+        if (!free.intersects(used)) {
+          next.push_back(free);
+          continue;
+        }
+        // Split what is left of `free` around `used` into up to four maximal rectangles
+        if (used.x > free.x) {
+          next.push_back({free.x, free.y, used.x - free.x, free.h});
+        }
+        if (used.right() < free.right()) {
+          next.push_back({used.right(), free.y, free.right() - used.right(), free.h});
+        }
+        if (used.y > free.y) {
+          next.push_back({free.x, free.y, free.w, used.y - free.y});
+        }
+        if (used.bottom() < free.bottom()) {
+          next.push_back({free.x, used.bottom(), free.w, free.bottom() - used.bottom()});
+        }
+      }
+
+      // Drop rectangles contained in another one
+      free_.clear();
+      for (size_t i = 0; i < next.size(); i++) {
+        bool contained = false;
+        for (size_t j = 0; j < next.size() && !contained; j++) {
+          contained = i != j && next[j].contains(next[i]) && (!next[i].contains(next[j]) || j < i);
+        }
+        if (!contained) {
+          free_.push_back(next[i]);
+        }
+      }
+    }
+
+    std::vector<Rect> free_;
+  };
+
+  inline size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+
+  // Packs `sizes` ({w, h} of each element) into the smallest bin found, starting from the total area and
+  // growing the shorter side until everything fits. The result is trimmed to the space actually used.
+  inline Result pack(const std::vector<Rect>& sizes, const Options& options) {
+    const size_t align = std::max<size_t>(1, options.block_align);
+    auto padded = [&](size_t extent) { return alignUp(extent + options.padding, align); };
+    auto bin_extent = [&](size_t extent) { return options.power_of_two ? std::bit_ceil(extent) : alignUp(extent, align); };
+
+    Result result;
+    result.rects.resize(sizes.size());
+    if (sizes.empty()) {
+      return result;
+    }
+
+    size_t area = 0, max_w = 0, max_h = 0;
+    for (const auto& size : sizes) {
+      area += padded(size.w) * padded(size.h);
+      max_w = std::max(max_w, padded(size.w));
+      max_h = std::max(max_h, padded(size.h));
+    }
+
+    // Biggest elements first, by their longest side then their area
+    std::vector<size_t> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      const size_t long_a = std::max(sizes[a].w, sizes[a].h), long_b = std::max(sizes[b].w, sizes[b].h);
+      return long_a != long_b ? long_a > long_b : sizes[a].w * sizes[a].h > sizes[b].w * sizes[b].h;
+    });
+
+    const auto side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(area))));
+    size_t bin_w = bin_extent(std::max(side, max_w)), bin_h = bin_extent(std::max(side, max_h));
+    while (true) {
+      MaxRectsBin bin(bin_w, bin_h);
+      bool fits = true;
+      for (size_t index : order) {
+        auto rect = bin.insert(padded(sizes[index].w), padded(sizes[index].h));
+        if (!rect.has_value()) {
+          fits = false;
+          break;
+        }
+        result.rects[index] = {rect->x, rect->y, sizes[index].w, sizes[index].h};
+      }
+      if (fits) {
+        break;
+      }
+
+      auto& grow = bin_w <= bin_h ? bin_w : bin_h;
+      grow = bin_extent(options.power_of_two ? grow * 2 : grow + std::max(align, grow / 16));
+    }
+
+    for (const auto& rect : result.rects) {
+      result.width = std::max(result.width, rect.right());
+      result.height = std::max(result.height, rect.bottom());
+    }
+    result.width = bin_extent(result.width);
+    result.height = bin_extent(result.height);
+    return result;
+  }
+}
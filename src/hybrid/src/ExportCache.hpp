@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+/*
+ * Per-document export cache.
+ * A small sidecar is kept next to each exported texture (`{name}.tex.cache`) recording the hash of
+ * the pixels and options it was encoded from, together with the size and write time of the .tex.
+ * An export whose source hash matches, and whose .tex was not touched since, can skip encoding.
+ */
+namespace ExportCache
+{
+  struct Record {
+    char magic[4] = {'T', 'X', 'C', 'H'};
+    uint32_t version = 1;
+    uint64_t source_hash = 0;
+    uint64_t tex_size = 0;
+    int64_t tex_write_time = 0;
+  };
+
+  inline std::filesystem::path sidecarPath(const std::filesystem::path& tex_file) {
+    auto path = tex_file;
+    return path += ".cache";
+  }
+
+  inline bool describe(const std::filesystem::path& tex_file, Record& record) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(tex_file, ec);
+    if (ec) {
+      return false;
+    }
+    auto write_time = std::filesystem::last_write_time(tex_file, ec);
+    if (ec) {
+      return false;
+    }
+    record.tex_size = size;
+    record.tex_write_time = static_cast<int64_t>(write_time.time_since_epoch().count());
+    return true;
+  }
+
+  // True if `tex_file` exists and was produced from a source hashing to `source_hash`
+  inline bool isUpToDate(const std::filesystem::path& tex_file, uint64_t source_hash) {
+    Record stored;
+    std::ifstream sidecar(sidecarPath(tex_file), std::ios::binary);
+    if (!sidecar.read(reinterpret_cast<char*>(&stored), sizeof(stored))) {
+      return false;
+    }
+
+    Record current;
+    if (std::memcmp(stored.magic, current.magic, sizeof(current.magic)) != 0 || stored.version != current.version) {
+      return false;
+    }
+    current.source_hash = source_hash;
+    return describe(tex_file, current) &&
+      stored.source_hash == current.source_hash &&
+      stored.tex_size == current.tex_size &&
+      stored.tex_write_time == current.tex_write_time;
+  }
+
+  // Records that `tex_file` was just written from a source hashing to `source_hash`.
+  // Failing to write the sidecar only costs a re-encode next time, so errors are ignored.
+  inline void store(const std::filesystem::path& tex_file, uint64_t source_hash) {
+    Record record;
+    record.source_hash = source_hash;
+    if (!describe(tex_file, record)) {
+      return;
+    }
+    std::ofstream sidecar(sidecarPath(tex_file), std::ios::binary | std::ios::trunc);
+    sidecar.write(reinterpret_cast<const char*>(&record), sizeof(record));
+  }
+
+  inline void invalidate(const std::filesystem::path& tex_file) {
+    std::error_code ec;
+    std::filesystem::remove(sidecarPath(tex_file), ec);
+  }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+
+/*
+ * Output files are never written in place. They are written to a temporary file in the same folder
+ * and renamed over the destination once complete, so readers (e.g. the game watching the folder)
+ * only ever see the previous file or the finished new one.
+ */
+namespace FileOutput
+{
+  struct WriteStats {
+    uintmax_t bytes = 0;
+    double milliseconds = 0;
+
+    [[nodiscard]] std::string describe() const {
+      return std::format("{} bytes in {:.1f} ms", bytes, milliseconds);
+    }
+  };
+
+  // Unique sibling of `path`, so concurrent exports to the same folder never share a temporary file
+  inline std::filesystem::path temporaryPathFor(const std::filesystem::path& path) {
+    static std::atomic<uint64_t> counter{0};
+    auto temporary = path;
+    return temporary += std::format(".{}-{}.tmp",
+      std::chrono::steady_clock::now().time_since_epoch().count(), counter.fetch_add(1));
+  }
+
+  // Atomically replaces `path` with the finished `temporary` file
+  inline void commit(const std::filesystem::path& temporary, const std::filesystem::path& path) {
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) {
+      std::filesystem::remove(temporary, ec);
+      throw std::runtime_error(std::format("Could not write {}", path.string()));
+    }
+  }
+
+  inline void discard(const std::filesystem::path& temporary) {
+    std::error_code ec;
+    std::filesystem::remove(temporary, ec);
+  }
+
+  // Writes `data` with a single bulk write, then moves it into place
+  inline WriteStats write(const std::filesystem::path& path, std::span<const uint8_t> data) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto temporary = temporaryPathFor(path);
+    {
+      std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+      if (!file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size())) || !file.flush()) {
+        file.close();
+        discard(temporary);
+        throw std::runtime_error(std::format("Could not write {}", path.string()));
+      }
+    }
+    commit(temporary, path);
+
+    return {data.size(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()};
+  }
+
+  // Lets `write_to(temporary)` produce the file, e.g. an encoder that can only write to a path, then moves
+  // it into place. The stats include the time spent in `write_to`.
+  template <class Write>
+  inline WriteStats writeWith(const std::filesystem::path& path, Write&& write_to) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto temporary = temporaryPathFor(path);
+    try {
+      write_to(temporary);
+    } catch (...) {
+      discard(temporary);
+      throw;
+    }
+
+    std::error_code ec;
+    const auto bytes = std::filesystem::file_size(temporary, ec);
+    commit(temporary, path);
+    return {ec ? 0 : bytes, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()};
+  }
+
+  inline WriteStats write(const std::filesystem::path& path, std::string_view data) {
+    return write(path, std::span(reinterpret_cast<const uint8_t*>(data.data()), data.size()));
+  }
+}
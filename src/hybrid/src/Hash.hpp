@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * Streaming 64 bit hash (XXH64).
+ * Input is consumed in 32 byte stripes spread over four independent lanes, which keeps the loop
+ * free of dependencies between lanes so it runs at memory speed on large pixel buffers.
+ */
+class Hasher {
+public:
+  explicit Hasher(uint64_t seed = 0)
+  : seed_(seed), lanes_{seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1} {}
+
+  Hasher& update(const void* data, size_t length) {
+    auto* input = static_cast<const uint8_t*>(data);
+    total_length_ += length;
+
+    if (buffered_ > 0) {
+      size_t take = std::min(length, sizeof(buffer_) - buffered_);
+      std::memcpy(buffer_ + buffered_, input, take);
+      buffered_ += take;
+      input += take;
+      length -= take;
+      if (buffered_ < sizeof(buffer_)) {
+        return *this;
+      }
+      consumeStripe(buffer_);
+      buffered_ = 0;
+    }
+
+    for (; length >= sizeof(buffer_); input += sizeof(buffer_), length -= sizeof(buffer_)) {
+      consumeStripe(input);
+    }
+
+    std::memcpy(buffer_, input, length);
+    buffered_ = length;
+    return *this;
+  }
+
+  template <class T, class = std::enable_if_t<std::is_trivially_copyable_v<T>>>
+  Hasher& update(const T& value) {
+    return update(&value, sizeof(T));
+  }
+
+  [[nodiscard]] uint64_t digest() const {
+    uint64_t hash;
+    if (total_length_ >= sizeof(buffer_)) {
+      hash = rotl(lanes_[0], 1) + rotl(lanes_[1], 7) + rotl(lanes_[2], 12) + rotl(lanes_[3], 18);
+      for (uint64_t lane : lanes_) {
+        hash = (hash ^ round(0, lane)) * kPrime1 + kPrime4;
+      }
+    }
+    else {
+      hash = seed_ + kPrime5;
+    }
+    hash += total_length_;
+
+    const uint8_t* tail = buffer_;
+    size_t remaining = buffered_;
+    for (; remaining >= 8; tail += 8, remaining -= 8) {
+      hash ^= round(0, read<uint64_t>(tail));
+      hash = rotl(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (remaining >= 4) {
+      hash ^= static_cast<uint64_t>(read<uint32_t>(tail)) * kPrime1;
+      hash = rotl(hash, 23) * kPrime2 + kPrime3;
+      tail += 4;
+      remaining -= 4;
+    }
+    for (; remaining > 0; tail++, remaining--) {
+      hash ^= *tail * kPrime5;
+      hash = rotl(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+  }
+
+private:
+  static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+  static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+  static constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+  static constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+  static constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+  static constexpr uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+  static constexpr uint64_t round(uint64_t acc, uint64_t input) {
+    return rotl(acc + input * kPrime2, 31) * kPrime1;
+  }
+
+  template <class T>
+  static T read(const uint8_t* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+  }
+
+  void consumeStripe(const uint8_t* stripe) {
+    lanes_[0] = round(lanes_[0], read<uint64_t>(stripe));
+    lanes_[1] = round(lanes_[1], read<uint64_t>(stripe + 8));
+    lanes_[2] = round(lanes_[2], read<uint64_t>(stripe + 16));
+    lanes_[3] = round(lanes_[3], read<uint64_t>(stripe + 24));
+  }
+
+  uint64_t seed_;
+  uint64_t lanes_[4];
+  uint8_t buffer_[32]{};
+  size_t buffered_ = 0;
+  uint64_t total_length_ = 0;
+};
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "Hash.hpp"
+
+/*
+ * Non-owning view over 8 bit interleaved pixels.
+ * `stride` is the distance in bytes between the start of two rows, so a view can describe a
+ * sub-rectangle of a bigger image or a buffer borrowed from JS without copying it.
+ */
+struct ImageView {
+  uint8_t* data = nullptr;
+  size_t width = 0, height = 0;
+  size_t channels = 0;
+  size_t stride = 0;
+
+  ImageView() = default;
+  ImageView(uint8_t* data, size_t width, size_t height, size_t channels)
+  : ImageView(data, width, height, channels, width * channels) {}
+  ImageView(uint8_t* data, size_t width, size_t height, size_t channels, size_t stride)
+  : data(data), width(width), height(height), channels(channels), stride(stride) {}
+
+  [[nodiscard]] uint8_t* row(size_t y) const { return data + y * stride; }
+
+  [[nodiscard]] size_t rowSize() const { return width * channels; }
+
+  // True when rows follow each other without padding, i.e. the view can be used as one flat buffer
+  [[nodiscard]] bool isContiguous() const { return stride == rowSize(); }
+
+  [[nodiscard]] size_t size() const { return height * rowSize(); }
+
+  // The [left, right) x [top, bottom) region of this view. Shares the same pixels.
+  [[nodiscard]] ImageView subview(size_t left, size_t top, size_t right, size_t bottom) const {
+    if (left > right || top > bottom || right > width || bottom > height) {
+      throw std::out_of_range(std::format("Subview [{}, {}) x [{}, {}) is outside of a {}x{} image",
+        left, right, top, bottom, width, height));
+    }
+    return {row(top) + left * channels, right - left, bottom - top, channels, stride};
+  }
+};
+
+// Feeds the size and the pixels of `image` to `hasher`, row by row when the view is strided
+inline Hasher& updateHash(Hasher& hasher, const ImageView& image) {
+  hasher.update(image.width).update(image.height).update(image.channels);
+  if (image.isContiguous()) {
+    return hasher.update(image.data, image.size());
+  }
+  for (size_t y = 0; y < image.height; y++) {
+    hasher.update(image.row(y), image.rowSize());
+  }
+  return hasher;
+}
+
+// Exact round(value * alpha / 255) for 8 bit inputs, without a division
+constexpr uint8_t premultiply(uint32_t value, uint32_t alpha) {
+  const uint32_t t = value * alpha + 128;
+  return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+}
+
+// Copies `src` into the RGBA view `dst` of the same size, optionally premultiplying color by alpha.
+// Expansion and premultiplication happen in the same pass, so every source row is read exactly once.
+inline void copyToRgba(const ImageView& src, const ImageView& dst, bool premultiply_alpha = false) {
+  if (dst.channels != 4 || src.width != dst.width || src.height != dst.height) {
+    throw std::invalid_argument("Destination must be an RGBA view with the source's dimensions");
+  }
+
+  const size_t width = src.width;
+  for (size_t y = 0; y < src.height; y++) {
+    const uint8_t* s = src.row(y);
+    uint8_t* d = dst.row(y);
+
+    switch (src.channels) {
+      case 4:
+        if (!premultiply_alpha) {
+          std::memcpy(d, s, width * 4);
+          break;
+        }
+        for (size_t x = 0; x < width; x++) {
+          const uint8_t a = s[x * 4 + 3];
+          d[x * 4 + 0] = premultiply(s[x * 4 + 0], a);
+          d[x * 4 + 1] = premultiply(s[x * 4 + 1], a);
+          d[x * 4 + 2] = premultiply(s[x * 4 + 2], a);
+          d[x * 4 + 3] = a;
+        }
+        break;
+      case 3:
+        for (size_t x = 0; x < width; x++) {
+          d[x * 4 + 0] = s[x * 3 + 0];
+          d[x * 4 + 1] = s[x * 3 + 1];
+          d[x * 4 + 2] = s[x * 3 + 2];
+          d[x * 4 + 3] = 255;
+        }
+        break;
+      case 1:
+        for (size_t x = 0; x < width; x++) {
+          d[x * 4 + 0] = d[x * 4 + 1] = d[x * 4 + 2] = s[x];
+          d[x * 4 + 3] = 255;
+        }
+        break;
+      default:
+        throw std::runtime_error(std::format("Unsupported channel count {}", src.channels));
+    }
+  }
+}
+
+struct AlphaStats {
+  uint8_t min = 255, max = 255;
+  // Every alpha value is either 0 or 255
+  bool binary = true;
+
+  [[nodiscard]] bool isOpaque() const { return min == 255; }
+  [[nodiscard]] bool isConstant() const { return min == max; }
+};
+
+// Single pass over the alpha channel. The inner loop has no branches so it vectorizes.
+inline AlphaStats analyzeAlpha(const ImageView& image) {
+  AlphaStats stats;
+  if (image.channels != 4) {
+    return stats;
+  }
+
+  uint8_t min = 255, max = 0;
+  uint8_t partial = 0;
+  for (size_t y = 0; y < image.height; y++) {
+    const uint8_t* row = image.row(y);
+    for (size_t x = 0; x < image.width; x++) {
+      const uint8_t a = row[x * 4 + 3];
+      min = std::min(min, a);
+      max = std::max(max, a);
+      partial |= static_cast<uint8_t>(a != 0 && a != 255);
+    }
+  }
+
+  if (image.width > 0 && image.height > 0) {
+    stats.min = min;
+    stats.max = max;
+    stats.binary = partial == 0;
+  }
+  return stats;
+}
+
+// Peak signal to noise ratio between two images of the same size, over all channels, in dB.
+// Identical images return infinity.
+inline double psnr(const ImageView& a, const ImageView& b) {
+  if (a.width != b.width || a.height != b.height || a.channels != b.channels) {
+    throw std::invalid_argument("PSNR needs images of the same size and layout");
+  }
+
+  uint64_t squared_error = 0;
+  for (size_t y = 0; y < a.height; y++) {
+    const uint8_t* ra = a.row(y);
+    const uint8_t* rb = b.row(y);
+    // Per row sums fit in 32 bits for rows up to 66k values, which keeps the inner loop vectorizable
+    uint32_t row_error = 0;
+    for (size_t x = 0; x < a.rowSize(); x++) {
+      const int32_t d = static_cast<int32_t>(ra[x]) - static_cast<int32_t>(rb[x]);
+      row_error += static_cast<uint32_t>(d * d);
+    }
+    squared_error += row_error;
+  }
+
+  if (squared_error == 0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  const double mse = static_cast<double>(squared_error) / static_cast<double>(a.size());
+  return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// Gathers up to `tiles_per_axis`² evenly spaced `tile`x`tile` tiles of `image` into one RGBA image stored in
+// `storage`. Images no bigger than the sample are copied whole.
+inline ImageView sampleTiles(const ImageView& image, size_t tile, size_t tiles_per_axis, std::vector<uint8_t>& storage) {
+  const size_t tiles_x = std::min(tiles_per_axis, std::max<size_t>(1, image.width / tile));
+  const size_t tiles_y = std::min(tiles_per_axis, std::max<size_t>(1, image.height / tile));
+  const size_t tile_w = std::min(tile, image.width), tile_h = std::min(tile, image.height);
+
+  storage.assign(tiles_x * tile_w * tiles_y * tile_h * 4, 0);
+  const ImageView sample(storage.data(), tiles_x * tile_w, tiles_y * tile_h, 4);
+
+  for (size_t ty = 0; ty < tiles_y; ty++) {
+    const size_t top = tiles_y == 1 ? 0 : ty * (image.height - tile_h) / (tiles_y - 1);
+    for (size_t tx = 0; tx < tiles_x; tx++) {
+      const size_t left = tiles_x == 1 ? 0 : tx * (image.width - tile_w) / (tiles_x - 1);
+      copyToRgba(
+        image.subview(left, top, left + tile_w, top + tile_h),
+        sample.subview(tx * tile_w, ty * tile_h, (tx + 1) * tile_w, (ty + 1) * tile_h)
+      );
+    }
+  }
+  return sample;
+}
+
+// 2x2 box filter from `src` into `dst`, which must be ceil(src / 2) in both directions with the same channels.
+// Odd edges repeat their last row or column, so pixel (x, y) of `dst` always covers (2x, 2y) of `src`.
+inline void downsample2x(const ImageView& src, const ImageView& dst) {
+  if (dst.channels != src.channels || dst.width != (src.width + 1) / 2 || dst.height != (src.height + 1) / 2) {
+    throw std::invalid_argument("Destination must be half the source's size with the same channels");
+  }
+
+  const size_t channels = src.channels;
+  for (size_t y = 0; y < dst.height; y++) {
+    const uint8_t* top = src.row(2 * y);
+    const uint8_t* bottom = src.row(std::min(2 * y + 1, src.height - 1));
+    uint8_t* d = dst.row(y);
+    for (size_t x = 0; x < dst.width; x++) {
+      const size_t left = 2 * x * channels;
+      const size_t right = std::min(2 * x + 1, src.width - 1) * channels;
+      for (size_t c = 0; c < channels; c++) {
+        d[x * channels + c] = static_cast<uint8_t>(
+          (top[left + c] + top[right + c] + bottom[left + c] + bottom[right + c] + 2) >> 2);
+      }
+    }
+  }
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "FileOutput.hpp"
+
+/*
+ * Content addressed store of encoded textures shared by every document.
+ * Entries are named after the hash of the source pixels and conversion options, so identical sheets
+ * exported from different documents are only encoded once. Hits are hard linked (or copied when the
+ * store is on another volume) into place. The least recently used entries are evicted once the store
+ * grows past its size cap.
+ * Recency is kept in the store's own `recency.bin` index rather than in file times: entries share their
+ * inode with exported textures, and touching them would change those files' write times too.
+ */
+class TextureStore {
+public:
+  struct Stats {
+    uint64_t hits = 0, misses = 0;
+    uint64_t entries = 0, bytes = 0;
+  };
+
+  TextureStore(std::filesystem::path folder, uint64_t max_bytes)
+  : folder_(std::move(folder)), max_bytes_(max_bytes) {}
+
+  static std::filesystem::path defaultFolder() {
+    return std::filesystem::temp_directory_path() / "PSTexTool" / "texture-store";
+  }
+
+  // Places the entry for `key` at `output_file`. Returns false, and counts a miss, if there is none.
+  bool fetch(uint64_t key, const std::filesystem::path& output_file) const {
+    const auto entry = entryPath(key);
+    std::error_code ec;
+    if (!std::filesystem::exists(entry, ec)) {
+      misses_++;
+      return false;
+    }
+
+    const auto temporary = FileOutput::temporaryPathFor(output_file);
+    std::filesystem::create_hard_link(entry, temporary, ec);
+    if (ec) {
+      ec.clear();
+      std::filesystem::copy_file(entry, temporary, std::filesystem::copy_options::overwrite_existing, ec);
+    }
+    if (ec) {
+      FileOutput::discard(temporary);
+      misses_++;
+      return false;
+    }
+    FileOutput::commit(temporary, output_file);
+
+    touch(key);
+    hits_++;
+    return true;
+  }
+
+  // Adds the encoded texture `tex_file` for `key`, linked or copied like a hit. The store is a cache,
+  // so failures are ignored.
+  void store(uint64_t key, const std::filesystem::path& tex_file) const {
+    std::error_code ec;
+    std::filesystem::create_directories(folder_, ec);
+    const auto entry = entryPath(key);
+    const auto temporary = FileOutput::temporaryPathFor(entry);
+    std::filesystem::create_hard_link(tex_file, temporary, ec);
+    if (ec) {
+      ec.clear();
+      std::filesystem::copy_file(tex_file, temporary, std::filesystem::copy_options::overwrite_existing, ec);
+    }
+    if (ec) {
+      FileOutput::discard(temporary);
+      return;
+    }
+    try {
+      FileOutput::commit(temporary, entry);
+    } catch (std::exception&) {
+      return;
+    }
+    touch(key);
+    evict();
+  }
+
+  [[nodiscard]] Stats stats() const {
+    Stats stats{hits_.load(), misses_.load()};
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(folder_, ec)) {
+      if (entry.path().extension() == ".tex") {
+        stats.entries++;
+        stats.bytes += entry.file_size(ec);
+      }
+    }
+    return stats;
+  }
+
+private:
+  [[nodiscard]] std::filesystem::path entryPath(uint64_t key) const {
+    return folder_ / std::format("{:016x}.tex", key);
+  }
+
+  struct RecencyRecord {
+    uint64_t key;
+    uint64_t last_used;
+  };
+  using Recency = std::unordered_map<uint64_t, uint64_t>;
+
+  [[nodiscard]] std::filesystem::path recencyPath() const { return folder_ / "recency.bin"; }
+
+  [[nodiscard]] Recency loadRecency() const {
+    Recency recency;
+    std::ifstream file(recencyPath(), std::ios::binary);
+    RecencyRecord record{};
+    while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+      recency[record.key] = record.last_used;
+    }
+    return recency;
+  }
+
+  void saveRecency(const Recency& recency) const {
+    std::vector<RecencyRecord> records;
+    records.reserve(recency.size());
+    for (const auto& [key, last_used] : recency) {
+      records.push_back({key, last_used});
+    }
+    try {
+      FileOutput::write(recencyPath(), std::span(reinterpret_cast<const uint8_t*>(records.data()), records.size() * sizeof(RecencyRecord)));
+    } catch (std::exception&) {}
+  }
+
+  // Marks `key` as just used. Uses are numbered rather than timed, so the order survives clock changes.
+  void touch(uint64_t key) const {
+    std::lock_guard lock(recency_mutex_);
+    auto recency = loadRecency();
+    uint64_t latest = 0;
+    for (const auto& entry : recency) {
+      latest = std::max(latest, entry.second);
+    }
+    recency[key] = latest + 1;
+    saveRecency(recency);
+  }
+
+  void evict() const {
+    struct Entry {
+      std::filesystem::path path;
+      uint64_t key;
+      uintmax_t size;
+    };
+
+    std::lock_guard lock(recency_mutex_);
+    auto recency = loadRecency();
+    std::vector<Entry> entries;
+    uintmax_t total = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(folder_, ec)) {
+      if (entry.path().extension() != ".tex") {
+        continue;
+      }
+      const auto stem = entry.path().stem().string();
+      uint64_t key = 0;
+      if (std::from_chars(stem.data(), stem.data() + stem.size(), key, 16).ptr != stem.data() + stem.size()) {
+        continue;
+      }
+      Entry info{entry.path(), key, entry.file_size(ec)};
+      if (!ec) {
+        total += info.size;
+        entries.push_back(std::move(info));
+      }
+    }
+    if (total <= max_bytes_) {
+      return;
+    }
+
+    // Entries missing from the index (e.g. left by a crash) are the first to go
+    auto last_used = [&recency](const Entry& entry) {
+      const auto found = recency.find(entry.key);
+      return found == recency.end() ? 0 : found->second;
+    };
+    std::sort(entries.begin(), entries.end(), [&](const Entry& a, const Entry& b) { return last_used(a) < last_used(b); });
+    for (const auto& entry : entries) {
+      if (total <= max_bytes_) {
+        break;
+      }
+      if (std::filesystem::remove(entry.path, ec)) {
+        total -= entry.size;
+        recency.erase(entry.key);
+      }
+    }
+    saveRecency(recency);
+  }
+
+  std::filesystem::path folder_;
+  uint64_t max_bytes_;
+
+  // Shared by every store, reported through textureStoreStats
+  static inline std::atomic<uint64_t> hits_{0}, misses_{0};
+  // Serializes read-modify-write of the recency index between threads
+  static inline std::mutex recency_mutex_;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <charconv>
+#include <string>
+#include <string_view>
+
+/*
+ * Helpers appending XML to a std::string buffer without going through std::format.
+ * Numbers use std::to_chars' shortest round trip representation, the same digits std::format("{}")
+ * produces, and text is escaped so names containing quotes or ampersands stay well formed.
+ */
+namespace XmlWriter
+{
+  // Escapes `text` for use in attribute values and element content
+  inline void appendEscaped(std::string& out, std::string_view text) {
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+      std::string_view entity;
+      switch (text[i]) {
+        case '&': entity = "&amp;"; break;
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        case '"': entity = "&quot;"; break;
+        case '\'': entity = "&apos;"; break;
+        default: continue;
+      }
+      out.append(text, start, i - start);
+      out += entity;
+      start = i + 1;
+    }
+    out.append(text, start);
+  }
+
+  inline void appendNumber(std::string& out, double value) {
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+  }
+
+  // Appends ` {name}="{value}"`
+  inline void appendAttribute(std::string& out, std::string_view name, double value) {
+    out += ' ';
+    out += name;
+    out += "=\"";
+    appendNumber(out, value);
+    out += '"';
+  }
+}
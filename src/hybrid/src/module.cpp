@@ -14,24 +14,41 @@
 #include <string_view>
 #include <format>
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <vector>
 #include <optional>
+#include <span>
 
 #include <chrono>
+#include <memory>
 #include <regex>
 
 #include <TexConverter/Converter.hpp>
 #include "stb_image.h"
 #include "stb_image_write.h"
 #include "pugixml.hpp"
+#include "ImageView.hpp"
+#include "Hash.hpp"
+#include "ExportCache.hpp"
+#include "JobQueue.hpp"
+#include "FileOutput.hpp"
+#include "TextureStore.hpp"
+#include "AtlasPacker.hpp"
+#include "XmlWriter.hpp"
+#include "AtlasBinary.hpp"
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
 #include <filesystem>
+#include <future>
 #include <fstream>
 #include <queue>
 #include <stack>
@@ -197,6 +214,25 @@ namespace
       return getOptionalProperty<T>(value, key).value_or(default_value);
     }
 
+    // Converts every element of the array property `key`. Missing properties give an empty vector.
+    template <class T>
+    static std::vector<T> getOptionalArrayProperty(addon_value value, std::string_view key) {
+      auto uxp_array = uxpGetOptionalProperty(value, key);
+      if (!uxp_array.has_value()) {
+        return {};
+      }
+
+      uint32_t length = 0;
+      Check(UxpAddonApis.uxp_addon_get_array_length(env_, uxp_array.value(), &length));
+
+      std::vector<T> result;
+      result.reserve(length);
+      for (uint32_t i = 0; i < length; i++) {
+        result.push_back(convert<T>(uxpGetElement(uxp_array.value(), i)));
+      }
+      return result;
+    }
+
     struct UxpWrapper {
       [[nodiscard]] addon_value uxpValue() const { return uxp_value_; }
 
@@ -209,23 +245,68 @@ namespace
     template <class T>
     struct ArrayBuffer : UxpWrapper {
       T* data = nullptr;
+      // Number of T elements, not bytes
       size_t length = 0;
 
       ArrayBuffer() = default;
       explicit ArrayBuffer(addon_value value)
       : UxpWrapper(value) {
-        Check(UxpAddonApis.uxp_addon_get_arraybuffer_info(env_, value, reinterpret_cast<void**>(&data), &length));
+        size_t byte_length = 0;
+        Check(UxpAddonApis.uxp_addon_get_arraybuffer_info(env_, value, reinterpret_cast<void**>(&data), &byte_length));
+        length = byte_length / sizeof(T);
       }
 
-      ArrayBuffer(size_t data_len, T* buffer) {
-        length = data_len;
-        Check(UxpAddonApis.uxp_addon_create_arraybuffer(env_, length, reinterpret_cast<void**>(&buffer), &uxp_value_));
+      explicit ArrayBuffer(size_t data_len)
+      : length(data_len) {
+        Check(UxpAddonApis.uxp_addon_create_arraybuffer(env_, length * sizeof(T), reinterpret_cast<void**>(&data), &uxp_value_));
       }
-      std::vector<T> toVector() {
+
+      // Hands `external_data` to JS without copying. `owner` keeps the memory alive and is destroyed by the
+      // finalizer once the ArrayBuffer is garbage collected.
+      template <class Owner>
+      ArrayBuffer(std::unique_ptr<Owner> owner, T* external_data, size_t data_len)
+      : data(external_data), length(data_len) {
+        auto finalize = [](addon_env, void*, void* hint) { delete static_cast<Owner*>(hint); };
+        Check(UxpAddonApis.uxp_addon_create_external_arraybuffer(env_, data, length * sizeof(T), finalize, owner.get(), &uxp_value_));
+        owner.release();
+      }
+
+      [[nodiscard]] addon_value toUint8Array() const {
+        addon_value uint8_array = nullptr;
+        Check(UxpAddonApis.uxp_addon_create_typedarray(env_, addon_uint8_array, length * sizeof(T), uxp_value_, 0, &uint8_array));
+        return uint8_array;
+      }
+
+      [[nodiscard]] std::vector<T> toVector() const {
         return {data, data + length};
       }
     };
 
+    // Native object shared with JS through an external value. The JS side holds its own reference,
+    // released by the finalizer once the value is garbage collected.
+    template <class T>
+    struct External : UxpWrapper {
+      std::shared_ptr<T> object;
+
+      explicit External(std::shared_ptr<T> native_object)
+      : object(std::move(native_object)) {
+        auto holder = std::make_unique<std::shared_ptr<T>>(object);
+        auto finalize = [](addon_env, void* data, void*) { delete static_cast<std::shared_ptr<T>*>(data); };
+        Check(UxpAddonApis.uxp_addon_create_external(env_, holder.get(), finalize, nullptr, &uxp_value_));
+        holder.release();
+      }
+
+      explicit External(addon_value value)
+      : UxpWrapper(value) {
+        if (typeof(value) != addon_external) {
+          throw std::runtime_error("Value is not a native handle");
+        }
+        void* data = nullptr;
+        Check(UxpAddonApis.uxp_addon_get_value_external(env_, value, &data));
+        object = *static_cast<std::shared_ptr<T>*>(data);
+      }
+    };
+
   private:
     static inline addon_env env_ = nullptr;
   };
@@ -244,27 +325,131 @@ namespace
   struct ImageData {
     Size size;
     uint8_t channels;
+    UxpHelper::ArrayBuffer<uint8_t> buffer;
     uint8_t* data;
 
     explicit ImageData(addon_value value)
     : size(UxpHelper::getProperty<Size>(value, "size")),
       channels(UxpHelper::getProperty<uint8_t>(value, "channels")),
-      data(UxpHelper::getProperty<UxpHelper::ArrayBuffer<uint8_t>>(value, "data").data) {}
+      buffer(UxpHelper::getProperty<UxpHelper::ArrayBuffer<uint8_t>>(value, "data")),
+      data(buffer.data) {}
+
+    // Borrows the JS buffer, it must outlive the view
+    [[nodiscard]] ImageView view() const {
+      ImageView view(data, static_cast<size_t>(size.w), static_cast<size_t>(size.h), channels);
+      if (view.size() > buffer.length * sizeof(uint8_t)) {
+        throw std::runtime_error(std::format("Image data holds {} bytes, expected {}", buffer.length * sizeof(uint8_t), view.size()));
+      }
+      return view;
+    }
   };
 
+  std::string_view pixelFormatName(TexConverter::PixelFormat pixel_format) {
+    switch (pixel_format) {
+      case TexConverter::PixelFormat::DXT1: return "DXT1";
+      case TexConverter::PixelFormat::DXT3: return "DXT3";
+      case TexConverter::PixelFormat::DXT5: return "DXT5";
+      case TexConverter::PixelFormat::ARGB: return "ARGB";
+      default: return "unknown format";
+    }
+  }
+
   struct ImageToTexConversionOptions {
-    TexConverter::PixelFormat pixel_format;
+    // pixelFormat value asking for the format to be picked from the image's alpha channel
+    static constexpr int64_t kAutoPixelFormat = -1;
+    static constexpr double kDefaultSharedCacheBytes = 1024.0 * 1024.0 * 1024.0;
+
+    // Additional encodings of the same source, written next to the main output as `{name}{suffix}.tex`
+    struct Target {
+      std::optional<TexConverter::PixelFormat> pixel_format;
+      std::string suffix;
+
+      explicit Target(addon_value value)
+      : pixel_format(parsePixelFormat(value)),
+        suffix(UxpHelper::getProperty<std::string>(value, "suffix")) {}
+    };
+
+    // Empty until resolved when the format is picked automatically
+    std::optional<TexConverter::PixelFormat> pixel_format;
     TexConverter::TextureType texture_type;
     TexConverter::MipmapFilter mipmap_filter;
     bool generate_mipmaps;
     bool pre_multiply_alpha;
+    bool skip_unchanged;
+    // Quality floor in dB for automatic formats. When set, the smallest format meeting it on a trial encode wins.
+    std::optional<double> target_psnr;
+    // When not empty, these replace the single output described by `pixel_format`
+    std::vector<Target> targets;
+    // Content addressed store shared by all documents, only set when JS opts in with `sharedCache`
+    std::optional<TextureStore> shared_store;
 
     explicit ImageToTexConversionOptions(addon_value value)
-    : pixel_format(UxpHelper::getOptionalProperty(value, "pixelFormat", TexConverter::PixelFormat::DXT5)),
+    : pixel_format(parsePixelFormat(value)),
       texture_type(UxpHelper::getOptionalProperty(value, "textureType", TexConverter::TextureType::OneD)),
       mipmap_filter(UxpHelper::getOptionalProperty(value, "mipmapFilter", TexConverter::MipmapFilter::Default)),
       generate_mipmaps(UxpHelper::getOptionalProperty(value, "generateMipmaps", false)),
-      pre_multiply_alpha(UxpHelper::getOptionalProperty(value, "preMultiplyAlpha", false)) {}
+      pre_multiply_alpha(UxpHelper::getOptionalProperty(value, "preMultiplyAlpha", false)),
+      skip_unchanged(UxpHelper::getOptionalProperty(value, "skipUnchanged", true)),
+      target_psnr(UxpHelper::getOptionalProperty<double>(value, "targetPsnr")),
+      targets(UxpHelper::getOptionalArrayProperty<Target>(value, "targets")) {
+      if (UxpHelper::getOptionalProperty(value, "sharedCache", false)) {
+        auto folder = UxpHelper::getOptionalProperty<std::string>(value, "sharedCacheFolder");
+        shared_store.emplace(
+          folder.has_value() ? std::filesystem::path(*folder) : TextureStore::defaultFolder(),
+          static_cast<uint64_t>(UxpHelper::getOptionalProperty(value, "sharedCacheMaxBytes", kDefaultSharedCacheBytes))
+        );
+      }
+    }
+
+    static std::optional<TexConverter::PixelFormat> parsePixelFormat(addon_value value) {
+      auto pixel_format = UxpHelper::getOptionalProperty<int64_t>(value, "pixelFormat")
+        .value_or(static_cast<int64_t>(TexConverter::PixelFormat::DXT5));
+      if (pixel_format == kAutoPixelFormat) {
+        return std::nullopt;
+      }
+      return static_cast<TexConverter::PixelFormat>(pixel_format);
+    }
+
+    // Picks the pixel format when it was left to be chosen automatically: DXT1 for opaque images and
+    // images whose alpha is only ever 0 or 255 (DXT1's 1 bit alpha), DXT5 otherwise.
+    // Returns a description of the choice, empty when the format was given explicitly.
+    std::string resolvePixelFormat(const ImageView& image) {
+      if (pixel_format.has_value()) {
+        return {};
+      }
+
+      const auto alpha = analyzeAlpha(image);
+      std::string_view reason;
+      if (alpha.isOpaque()) {
+        pixel_format = TexConverter::PixelFormat::DXT1;
+        reason = "opaque";
+      }
+      else if (alpha.binary) {
+        pixel_format = TexConverter::PixelFormat::DXT1;
+        reason = "1 bit alpha";
+      }
+      else {
+        pixel_format = TexConverter::PixelFormat::DXT5;
+        reason = alpha.isConstant() ? "constant alpha" : "alpha gradients";
+      }
+      return std::format("{}, {}", pixelFormatName(*pixel_format), reason);
+    }
+
+    // Hash of everything that affects the encoded output. An automatic format is hashed as requested, with
+    // its quality floor, as the same pixels always resolve to the same format. Hashing before resolving lets
+    // unchanged exports skip the alpha scan and the trial encodes too.
+    [[nodiscard]] uint64_t hashWith(const ImageView& image) const {
+      constexpr int32_t kAutomatic = -1;
+      Hasher hasher;
+      return updateHash(hasher, image)
+        .update(pixel_format.has_value() ? static_cast<int32_t>(*pixel_format) : kAutomatic)
+        .update(pixel_format.has_value() ? 0.0 : target_psnr.value_or(0.0))
+        .update(texture_type)
+        .update(mipmap_filter)
+        .update(generate_mipmaps)
+        .update(pre_multiply_alpha)
+        .digest();
+    }
   };
 
   struct Layer : UxpHelper::UxpWrapper {
@@ -273,6 +458,9 @@ namespace
       double width, height;
 
       Bounds() = default;
+      Bounds(double left, double top, double right, double bottom)
+      : left(left), bottom(bottom), right(right), top(top), width(right - left), height(bottom - top) {}
+
       explicit Bounds(addon_value value)
       : left(UxpHelper::getProperty<double>(value, "left")),
         bottom(UxpHelper::getProperty<double>(value, "bottom")),
@@ -291,6 +479,8 @@ namespace
 
     std::string name;
     Bounds bounds{};
+    // Only known up front for layers read from a snapshot, otherwise read on demand with `getId`
+    std::optional<double> id;
 
     Layer() = default;
     explicit Layer(addon_value value)
@@ -298,16 +488,62 @@ namespace
       name(UxpHelper::getProperty<std::string>(value, "name")),
       bounds(UxpHelper::getProperty<Bounds>(value, "bounds")) {}
 
+    Layer(std::string name, const Bounds& bounds, double id)
+    : name(std::move(name)), bounds(bounds), id(id) {}
+
+    [[nodiscard]] double getId() const {
+      return id.has_value() ? *id : UxpHelper::getProperty<double>(uxpValue(), "id");
+    }
+
     static std::optional<addon_value> getUxpLayers(addon_value value) {
       return UxpHelper::uxpGetOptionalProperty(value, "layers");
     }
   };
 
+  /*
+   * Leaf layers collected by JS with a single batchPlay call, so the atlas code doesn't have to go through
+   * Photoshop's DOM proxies for every property of every layer.
+   *   {names: string[], bounds: ArrayBuffer}
+   * `bounds` holds 5 doubles per layer: id, left, top, right, bottom.
+   */
+  struct LayerSnapshot {
+    static constexpr size_t kValuesPerLayer = 5;
+
+    std::vector<std::string> names;
+    UxpHelper::ArrayBuffer<double> bounds;
+
+    explicit LayerSnapshot(addon_value value)
+    : names(UxpHelper::getOptionalArrayProperty<std::string>(value, "names")),
+      bounds(UxpHelper::getProperty<UxpHelper::ArrayBuffer<double>>(value, "bounds")) {
+      if (bounds.length < names.size() * kValuesPerLayer) {
+        throw std::runtime_error(std::format("Layer snapshot has {} names but only {} bounds values",
+          names.size(), bounds.length));
+      }
+    }
+
+    [[nodiscard]] Layer layer(size_t index) const {
+      const double* values = bounds.data + index * kValuesPerLayer;
+      return {names[index], Layer::Bounds(values[1], values[2], values[3], values[4]), values[0]};
+    }
+  };
+
   struct Document : UxpHelper::UxpWrapper {
     const std::string name;
     const std::string_view name_no_ext;
     const Size size;
     const std::optional<Size> grid;
+    // Number of additional half resolution exports, e.g. 2 for 0.5x and 0.25x
+    const size_t scaled_variants;
+    const bool pad_to_power_of_two;
+    // Also write the `.atlas` binary sidecar next to each XML atlas
+    const bool binary_atlas;
+    // Store a perfect hash over the element names in the binary sidecar
+    const bool atlas_name_index;
+    // When set, layers are read from it instead of `uxp_layers`
+    const std::optional<LayerSnapshot> layer_snapshot;
+    // Suffix of each target texture exported from the document, a single empty suffix without targets.
+    // Every layout gets one atlas per suffix.
+    const std::vector<std::string> texture_suffixes;
 
     addon_value__* uxp_layers;
 
@@ -317,9 +553,40 @@ namespace
       name_no_ext(name.ends_with(".psd") ? std::string_view{name}.substr(0, name.size() - 4) : name),
       size(UxpHelper::getProperty<double>(value, "width"), UxpHelper::getProperty<double>(value, "height")),
       grid(UxpHelper::getOptionalProperty<Size>(value, "grid")),
+      scaled_variants(UxpHelper::getOptionalProperty(value, "scaledVariants", size_t{0})),
+      pad_to_power_of_two(UxpHelper::getOptionalProperty(value, "padToPowerOfTwo", false)),
+      binary_atlas(UxpHelper::getOptionalProperty(value, "binaryAtlas", true)),
+      atlas_name_index(UxpHelper::getOptionalProperty(value, "atlasNameIndex", false)),
+      layer_snapshot(layerSnapshot(value)),
+      texture_suffixes(textureSuffixes(value)),
       uxp_layers(UxpHelper::uxpGetProperty(value, "layers")) {}
 
+    // Built directly rather than through getOptionalProperty, which would replace the snapshot's own
+    // validation errors with a generic conversion error
+    static std::optional<LayerSnapshot> layerSnapshot(addon_value value) {
+      const auto uxp_snapshot = UxpHelper::uxpGetOptionalProperty(value, "layerSnapshot");
+      if (!uxp_snapshot.has_value()) {
+        return std::nullopt;
+      }
+      return LayerSnapshot(*uxp_snapshot);
+    }
+
+    static std::vector<std::string> textureSuffixes(addon_value value) {
+      auto suffixes = UxpHelper::getOptionalArrayProperty<std::string>(value, "textureSuffixes");
+      if (suffixes.empty()) {
+        suffixes.emplace_back();
+      }
+      return suffixes;
+    }
+
     void iterateLayers(const std::function<void(const Document&, Layer&&)>& callback) const {
+      if (layer_snapshot.has_value()) {
+        for (size_t i = 0; i < layer_snapshot->names.size(); i++) {
+          callback(*this, layer_snapshot->layer(i));
+        }
+        return;
+      }
+
       std::deque groups{uxp_layers};
 
       while (!groups.empty()) {
@@ -341,6 +608,36 @@ namespace
     }
   };
 
+  // One resolution of an exported document, written as `{name}{suffix}.tex` and `{name}{suffix}.xml`.
+  // Each scaled variant is half of the previous one, like a mip level. Scaled variants can be padded to a
+  // power of two canvas, the image then sits in its bottom left corner where the atlas' UVs start.
+  struct VariantLayout {
+    std::string suffix;
+    int level = 0;
+    size_t width = 0, height = 0;
+    size_t canvas_w = 0, canvas_h = 0;
+
+    [[nodiscard]] bool isPadded() const { return canvas_w != width || canvas_h != height; }
+  };
+
+  // The 1x layout of `doc` followed by its scaled variants
+  std::vector<VariantLayout> variantLayouts(const Document& doc) {
+    auto width = static_cast<size_t>(doc.size.w), height = static_cast<size_t>(doc.size.h);
+    std::vector<VariantLayout> layouts{{"", 0, width, height, width, height}};
+
+    for (int level = 1; level <= static_cast<int>(doc.scaled_variants); level++) {
+      width = (width + 1) / 2;
+      height = (height + 1) / 2;
+      layouts.push_back({
+        std::format("@{}x", std::ldexp(1.0, -level)), level,
+        width, height,
+        doc.pad_to_power_of_two ? std::bit_ceil(width) : width,
+        doc.pad_to_power_of_two ? std::bit_ceil(height) : height
+      });
+    }
+    return layouts;
+  }
+
   // auto flattenLayers = [&layers, &get_uxp_layer, &msg, flatten_layers](addon_value uxp_layers) {
   //   auto length = UxpHelper::getProperty<size_t>(uxp_layers, "length");
   //   for (size_t lidx = 0; lidx < length; lidx++) {
@@ -358,6 +655,127 @@ namespace
   // };
 
 
+  // Atlas of one texture, as XML and as the binary sidecar. Written as `{name}{suffix}.xml`, next to the
+  // `{name}{suffix}.tex` it describes.
+  struct Atlas {
+    std::string suffix;
+    std::string xml;
+    // Empty when the document doesn't want the binary sidecar
+    std::vector<uint8_t> binary;
+  };
+
+  // Builds the atlas of every texture exported from `doc`, one per layout and target, in a single walk over
+  // the leaf layers of `doc` so each layer is only read once. Layers are snapped to the document's grid if
+  // it has one. Targets of a layout share its UVs, only the texture they name differs.
+  // Without a layer snapshot it walks the JS layer tree, so it must run on the scripting thread.
+  std::vector<Atlas> buildAtlases(const Document& doc, const std::vector<VariantLayout>& layouts) {
+    // An element takes at most ~130 bytes plus its name, so snapshots let the buffers be sized up front
+    size_t capacity = 4096;
+    if (doc.layer_snapshot.has_value()) {
+      for (const auto& name : doc.layer_snapshot->names) {
+        capacity += name.size() + 136;
+      }
+    }
+
+    std::vector<Atlas> result;
+    for (const auto& layout : layouts) {
+      for (const auto& texture_suffix : doc.texture_suffixes) {
+        result.emplace_back().suffix = layout.suffix + texture_suffix;
+      }
+    }
+
+    std::vector<std::string> elements(layouts.size());
+    std::vector<AtlasBinary::Writer> binaries;
+    for (size_t i = 0; i < layouts.size(); i++) {
+      elements[i].reserve(capacity);
+    }
+    if (doc.binary_atlas) {
+      for (const auto& atlas : result) {
+        binaries.emplace_back(std::format("{}{}.tex", doc.name_no_ext, atlas.suffix), doc.atlas_name_index);
+      }
+    }
+
+    doc.iterateLayers([&elements, &binaries, &layouts](const Document& doc, Layer&& layer) {
+        layer.bounds.bottom = doc.size.h - layer.bounds.bottom;
+        layer.bounds.top = doc.size.h - layer.bounds.top;
+
+        if (doc.grid.has_value() && !layer.bounds.isInsideGrid(doc.grid.value())) {
+          layer.bounds.left = std::floor(layer.bounds.left / doc.grid->w) * doc.grid->w;
+          layer.bounds.right = layer.bounds.left + std::ceil(layer.bounds.width / doc.grid->w) * doc.grid->w;
+          layer.bounds.bottom = std::floor(layer.bounds.bottom / doc.grid->h) * doc.grid->h;
+          layer.bounds.top = layer.bounds.bottom + std::ceil(layer.bounds.height / doc.grid->h) * doc.grid->h;
+        }
+
+        for (size_t i = 0; i < layouts.size(); i++) {
+          // Scaled pixels map to (x, y) * scale from the top left, v is measured from the bottom of the canvas
+          const auto& layout = layouts[i];
+          const double scale = std::ldexp(1.0, -layout.level);
+          const double canvas_w = static_cast<double>(layout.canvas_w), canvas_h = static_cast<double>(layout.canvas_h);
+          const double height = static_cast<double>(layout.height);
+
+          double u1 = layer.bounds.left * scale / canvas_w, u2 = layer.bounds.right * scale / canvas_w;
+          double v1 = (height - (doc.size.h - layer.bounds.bottom) * scale) / canvas_h;
+          double v2 = (height - (doc.size.h - layer.bounds.top) * scale) / canvas_h;
+
+          auto& atlas = elements[i];
+          atlas += "    <Element name=\"";
+          XmlWriter::appendEscaped(atlas, layer.name);
+          atlas += ".tex\"";
+          XmlWriter::appendAttribute(atlas, "u1", u1);
+          XmlWriter::appendAttribute(atlas, "u2", u2);
+          XmlWriter::appendAttribute(atlas, "v1", v1);
+          XmlWriter::appendAttribute(atlas, "v2", v2);
+          atlas += " />\n";
+
+          if (!binaries.empty()) {
+            const size_t targets = doc.texture_suffixes.size();
+            for (size_t j = 0; j < targets; j++) {
+              binaries[i * targets + j].add(layer.name + ".tex", u1, u2, v1, v2);
+            }
+          }
+        }
+      }
+    );
+
+    for (size_t k = 0; k < result.size(); k++) {
+      auto& atlas = result[k];
+      const auto& layout_elements = elements[k / doc.texture_suffixes.size()];
+      atlas.xml.reserve(layout_elements.size() + 256);
+      atlas.xml += "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                   "<Atlas>\n"
+                   "  <Texture filename=\"";
+      XmlWriter::appendEscaped(atlas.xml, doc.name_no_ext);
+      XmlWriter::appendEscaped(atlas.xml, atlas.suffix);
+      atlas.xml += ".tex\" />\n"
+                   "  <Elements>\n";
+      atlas.xml += layout_elements;
+      atlas.xml += "  </Elements>\n";
+      atlas.xml += "</Atlas>\n";
+      if (!binaries.empty()) {
+        atlas.binary = binaries[k].serialize();
+      }
+    }
+    return result;
+  }
+
+  // Writes every atlas into `folder`. Returns one message per file.
+  std::string writeAtlases(const std::string& folder, std::string_view name, const std::vector<Atlas>& atlases) {
+    std::string messages;
+    for (const auto& atlas : atlases) {
+      const auto path = std::format("{}/{}{}.xml", folder, name, atlas.suffix);
+      // The whole document is built in memory and written with a single call
+      const auto stats = FileOutput::write(path, atlas.xml);
+      messages += std::format("{}Succesfully exported {} ({}).", messages.empty() ? "" : "\n", path, stats.describe());
+
+      if (!atlas.binary.empty()) {
+        const auto binary_path = std::format("{}/{}{}.atlas", folder, name, atlas.suffix);
+        const auto binary_stats = FileOutput::write(binary_path, atlas.binary);
+        messages += std::format("\nSuccesfully exported {} ({}).", binary_path, binary_stats.describe());
+      }
+    }
+    return messages;
+  }
+
   /*
  * This function will echo the provided argument after converting to and from a
  * standard value type.
@@ -369,48 +787,335 @@ namespace
     try {
       auto args = UxpHelper::getArgs<2>(info);
       Document doc(args[0]);
-      std::string output_path = std::format("{}/{}.xml", UxpHelper::getString(args[1]), doc.name_no_ext);
-
-      std::ofstream atlasf(output_path);
-      atlasf << std::format(
-        "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
-        "<Atlas>\n"
-        "  <Texture filename=\"{}.tex\" />\n"
-        "  <Elements>\n",
-        doc.name_no_ext
-      );
-
-      doc.iterateLayers([&atlasf](const Document& doc, Layer&& layer) {
-          layer.bounds.bottom = doc.size.h - layer.bounds.bottom;
-          layer.bounds.top = doc.size.h - layer.bounds.top;
-
-          if (doc.grid.has_value() && !layer.bounds.isInsideGrid(doc.grid.value())) {
-            layer.bounds.left = std::floor(layer.bounds.left / doc.grid->w) * doc.grid->w;
-            layer.bounds.right = layer.bounds.left + std::ceil(layer.bounds.width / doc.grid->w) * doc.grid->w;
-            layer.bounds.bottom = std::floor(layer.bounds.bottom / doc.grid->h) * doc.grid->h;
-            layer.bounds.top = layer.bounds.bottom + std::ceil(layer.bounds.height / doc.grid->h) * doc.grid->h;
-          }
+      const auto layouts = variantLayouts(doc);
 
-          double u1 = layer.bounds.left / doc.size.w, u2 = layer.bounds.right / doc.size.w;
-          double v1 = layer.bounds.bottom / doc.size.h, v2 = layer.bounds.top / doc.size.h;
+      return Value(writeAtlases(UxpHelper::getString(args[1]), doc.name_no_ext, buildAtlases(doc, layouts))).Convert(env);
+    } catch (...) {
+      return CreateErrorFromException(env);
+    }
+  }
 
-          atlasf << std::format("    <Element name=\"{}.tex\" u1=\"{}\" u2=\"{}\" v1=\"{}\" v2=\"{}\" />\n",
-            layer.name,
-            u1, u2,
-            v1, v2
-          );
+  /*
+   * Lays the leaf layers of `doc` out automatically instead of keeping the artist's placement.
+   * JS moves each layer by (x - left, y - top) and resizes the canvas to the packed size, the atlas
+   * exported from that document then describes the packed rects.
+   *   packAtlas(doc, {padding?, blockAlign?, powerOfTwo?})
+   *     -> {width, height, elements: [{id, name, left, top, x, y, w, h}]}
+   */
+  addon_value packAtlas(addon_env env, addon_callback_info info) {
+    try {
+      auto args = UxpHelper::getArgs<2>(info);
+      const Document doc(args[0]);
+      AtlasPacker::Options options;
+      options.padding = UxpHelper::getOptionalProperty(args[1], "padding", size_t{0});
+      options.block_align = UxpHelper::getOptionalProperty(args[1], "blockAlign", size_t{4});
+      options.power_of_two = UxpHelper::getOptionalProperty(args[1], "powerOfTwo", false);
+
+      struct Element {
+        double id;
+        std::string name;
+        double left, top;
+      };
+      std::vector<Element> elements;
+      std::vector<AtlasPacker::Rect> sizes;
+      doc.iterateLayers([&elements, &sizes](const Document&, Layer&& layer) {
+          // Whole layer bounds, even past the canvas: JS moves the whole layer, so its packed rect must
+          // hold all of it and the offset must come from its real, possibly negative, left and top
+          const double left = std::floor(layer.bounds.left);
+          const double top = std::floor(layer.bounds.top);
+          const double right = std::max(left, std::ceil(layer.bounds.right));
+          const double bottom = std::max(top, std::ceil(layer.bounds.bottom));
+          elements.push_back({layer.getId(), std::move(layer.name), left, top});
+          sizes.push_back({0, 0, static_cast<size_t>(right - left), static_cast<size_t>(bottom - top)});
         }
       );
 
-      atlasf << "  </Elements>\n";
-      atlasf << "</Atlas>\n";
+      const auto packed = AtlasPacker::pack(sizes, options);
+
+      Value result(Value::Kind::map);
+      result.GetMap().emplace("width", Value(static_cast<double>(packed.width)));
+      result.GetMap().emplace("height", Value(static_cast<double>(packed.height)));
+      Value packed_elements(Value::Kind::list);
+      for (size_t i = 0; i < elements.size(); i++) {
+        const auto& rect = packed.rects[i];
+        Value element(Value::Kind::map);
+        element.GetMap().emplace("id", Value(elements[i].id));
+        element.GetMap().emplace("name", Value(elements[i].name));
+        element.GetMap().emplace("left", Value(elements[i].left));
+        element.GetMap().emplace("top", Value(elements[i].top));
+        element.GetMap().emplace("x", Value(static_cast<double>(rect.x)));
+        element.GetMap().emplace("y", Value(static_cast<double>(rect.y)));
+        element.GetMap().emplace("w", Value(static_cast<double>(rect.w)));
+        element.GetMap().emplace("h", Value(static_cast<double>(rect.h)));
+        packed_elements.GetList().push_back(std::move(element));
+      }
+      result.GetMap().emplace("elements", std::move(packed_elements));
 
-      return Value(std::format("Succesfully exported {}.", output_path)).Convert(env);
+      return result.Convert(env);
     } catch (...) {
       return CreateErrorFromException(env);
     }
   }
 
+  // Encodes `image` into the .tex file `path`. The pixel format must be resolved.
+  void encodeTexToFile(const ImageView& image, const std::filesystem::path& path, const ImageToTexConversionOptions& options) {
+    // The converter only takes tightly packed pixels, strided views are packed first
+    std::vector<uint8_t> packed;
+    uint8_t* pixels = image.data;
+    if (!image.isContiguous()) {
+      packed.resize(image.size());
+      for (size_t y = 0; y < image.height; y++) {
+        std::memcpy(packed.data() + y * image.rowSize(), image.row(y), image.rowSize());
+      }
+      pixels = packed.data();
+    }
+
+    TexConverter::convertImageToTex(
+      Image::Image8(pixels, image.width, image.height, image.channels),
+      path.string(),
+      options.pixel_format.value(),
+      options.mipmap_filter,
+      options.texture_type,
+      options.generate_mipmaps,
+      options.pre_multiply_alpha
+    );
+  }
+
+  // Encodes `image` into the bytes of a .tex file. The converter can only write to a file, so this goes
+  // through a scratch file in the local temp folder and reads it back. Exports that end up in a file
+  // use encodeTexToFile directly instead.
+  std::vector<uint8_t> encodeTex(const ImageView& image, const ImageToTexConversionOptions& options) {
+    const auto scratch = FileOutput::temporaryPathFor(std::filesystem::temp_directory_path() / "PSTexTool.tex");
+    std::vector<uint8_t> encoded;
+    try {
+      encodeTexToFile(image, scratch, options);
+
+      std::ifstream file(scratch, std::ios::binary | std::ios::ate);
+      const auto size = file ? static_cast<std::streamoff>(file.tellg()) : std::streamoff{-1};
+      if (size < 0) {
+        throw std::runtime_error("Could not read the encoded texture");
+      }
+      encoded.resize(static_cast<size_t>(size));
+      file.seekg(0);
+      if (!file.read(reinterpret_cast<char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()))) {
+        throw std::runtime_error("Could not read the encoded texture");
+      }
+    } catch (...) {
+      FileOutput::discard(scratch);
+      throw;
+    }
+    FileOutput::discard(scratch);
+
+    return encoded;
+  }
+
+  // Encodes `image` to a scratch file and decodes it back, to measure what an encoding loses
+  Image::Image8 roundTripTex(const ImageView& image, const ImageToTexConversionOptions& options) {
+    const auto scratch = FileOutput::temporaryPathFor(std::filesystem::temp_directory_path() / "PSTexTool.tex");
+    try {
+      encodeTexToFile(image, scratch, options);
+      auto decoded = TexConverter::convertTexToImage(scratch.string());
+      FileOutput::discard(scratch);
+      return decoded;
+    } catch (...) {
+      FileOutput::discard(scratch);
+      throw;
+    }
+  }
+
+  // Picks the smallest pixel format whose PSNR on a sample of `image` meets `options.target_psnr`.
+  // The sample (up to 4x4 tiles of 64x64 spread over the image) is encoded without mipmaps with each
+  // candidate, from the smallest to the largest, and decoded back to measure it. ARGB is lossless so it
+  // always meets the floor. DXT1 is only tried when its 1 bit alpha can represent the image.
+  std::string tunePixelFormat(const ImageView& image, ImageToTexConversionOptions& options) {
+    std::vector<uint8_t> storage;
+    const auto sample = sampleTiles(image, 64, 4, storage);
+    if (options.pre_multiply_alpha) {
+      copyToRgba(sample, sample, true);
+    }
+
+    auto trial_options = options;
+    trial_options.generate_mipmaps = false;
+    trial_options.pre_multiply_alpha = false;
+
+    std::vector<TexConverter::PixelFormat> candidates;
+    if (analyzeAlpha(sample).binary) {
+      candidates.push_back(TexConverter::PixelFormat::DXT1);
+    }
+    candidates.push_back(TexConverter::PixelFormat::DXT5);
+
+    for (const auto candidate : candidates) {
+      trial_options.pixel_format = candidate;
+      auto decoded = roundTripTex(sample, trial_options);
+      const ImageView decoded_view(decoded.data(),
+        static_cast<size_t>(decoded.width()), static_cast<size_t>(decoded.height()), static_cast<size_t>(decoded.channels()));
+      // The decoder may pad the image to whole blocks, only the sample's own pixels are compared
+      if (decoded_view.width < sample.width || decoded_view.height < sample.height || decoded_view.channels != sample.channels) {
+        throw std::runtime_error(std::format("{} decoded to an unexpected size", pixelFormatName(candidate)));
+      }
+
+      const double quality = psnr(sample, decoded_view.subview(0, 0, sample.width, sample.height));
+      if (quality >= *options.target_psnr) {
+        options.pixel_format = candidate;
+        return std::format("{}, {:.1f} dB >= {} dB", pixelFormatName(candidate), quality, *options.target_psnr);
+      }
+    }
+
+    options.pixel_format = TexConverter::PixelFormat::ARGB;
+    return std::format("ARGB, compressed formats are below {} dB", *options.target_psnr);
+  }
+
+  // Resolves an automatic pixel format, by trial encoding when a quality floor was given and from the
+  // alpha channel otherwise. Returns a description of the choice, empty when the format was explicit.
+  std::string choosePixelFormat(const ImageView& image, ImageToTexConversionOptions& options) {
+    if (!options.pixel_format.has_value() && options.target_psnr.has_value()) {
+      // Tuning only picks the format, if a trial fails the export goes on with the alpha based choice
+      try {
+        return tunePixelFormat(image, options);
+      } catch (const std::exception& e) {
+        options.pixel_format.reset();
+        return std::format("{}, tuning failed: {}", options.resolvePixelFormat(image), e.what());
+      }
+    }
+    return options.resolvePixelFormat(image);
+  }
+
+  // Encodes `image` to `output_file` unless the sidecar cache shows the file was already exported from the
+  // same pixels and options, or the shared texture store already holds that encoding.
+  // Picks the pixel format if it is automatic, only once neither cache has the file.
+  // Returns the message reported back to JS.
+  std::string exportTexFile(const ImageView& image, const std::string& output_file, ImageToTexConversionOptions options) {
+    std::optional<uint64_t> source_hash;
+    if (options.skip_unchanged || options.shared_store.has_value()) {
+      source_hash = options.hashWith(image);
+    }
+
+    if (options.skip_unchanged && ExportCache::isUpToDate(output_file, *source_hash)) {
+      return std::format("{} is up to date.", output_file);
+    }
+    ExportCache::invalidate(output_file);
+
+    std::string message;
+    if (options.shared_store.has_value() && options.shared_store->fetch(*source_hash, output_file)) {
+      message = std::format("Successfully exported {} from the texture store.", output_file);
+    }
+    else {
+      const auto auto_format = choosePixelFormat(image, options);
+      const auto suffix = auto_format.empty() ? "." : std::format(" as {}.", auto_format);
+      // Encoded straight into a temporary next to the output and renamed into place, without a round trip
+      // through memory
+      const auto stats = FileOutput::writeWith(output_file, [&image, &options](const std::filesystem::path& temporary) {
+        encodeTexToFile(image, temporary, options);
+      });
+      if (options.shared_store.has_value()) {
+        options.shared_store->store(*source_hash, output_file);
+      }
+      message = std::format("Successfully exported {} ({}){}", output_file, stats.describe(), suffix);
+    }
+
+    if (options.skip_unchanged) {
+      ExportCache::store(output_file, *source_hash);
+    }
+    return message;
+  }
+
+  // Writes every target of `options`, or just `output_file` when there are none. Targets share the prepared
+  // source and are encoded each into `{output_file without .tex}{suffix}.tex`, in parallel by default.
+  // Callers already running on a JobQueue pass std::launch::deferred so targets are encoded one after the
+  // other on the job's thread and the queue's concurrency stays the limit.
+  std::string exportTexTargets(const ImageView& image, const std::string& output_file, const ImageToTexConversionOptions& options,
+                               std::launch policy = std::launch::async) {
+    if (options.targets.empty()) {
+      return exportTexFile(image, output_file, options);
+    }
+
+    const auto base = std::filesystem::path(output_file).replace_extension().string();
+    std::vector<std::future<std::string>> exports;
+    exports.reserve(options.targets.size());
+    for (const auto& target : options.targets) {
+      auto target_options = options;
+      target_options.pixel_format = target.pixel_format;
+      target_options.targets.clear();
+
+      exports.push_back(std::async(policy,
+        [&image, target_file = std::format("{}{}.tex", base, target.suffix), target_options] {
+          return exportTexFile(image, target_file, target_options);
+        }
+      ));
+    }
+
+    // Wait for every target even if one fails, `image` must stay alive until all of them are done
+    std::string messages;
+    std::exception_ptr error;
+    for (auto& result : exports) {
+      try {
+        messages += (messages.empty() ? "" : "\n") + result.get();
+      } catch (...) {
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return messages;
+  }
+
+  // Exports `image` at every resolution of `layouts`, the 1x layout to `output_file` and the scaled ones next
+  // to it. Each level is box filtered from the previous one, so the chain is only computed once.
+  std::string exportTexVariants(const ImageView& image, const std::string& output_file,
+                                const ImageToTexConversionOptions& options, const std::vector<VariantLayout>& layouts,
+                                std::launch policy = std::launch::async) {
+    std::string messages = exportTexTargets(image, output_file, options, policy);
+
+    const auto base = std::filesystem::path(output_file).replace_extension().string();
+    std::vector<uint8_t> level_pixels, previous_pixels, canvas_pixels;
+    ImageView level = image;
+    for (size_t i = 1; i < layouts.size(); i++) {
+      const auto& layout = layouts[i];
+      // `level` keeps pointing at the previous pixels, swapping vectors doesn't move their buffers
+      previous_pixels.swap(level_pixels);
+      level_pixels.resize(layout.width * layout.height * image.channels);
+      const ImageView next(level_pixels.data(), layout.width, layout.height, image.channels);
+      downsample2x(level, next);
+      level = next;
+
+      ImageView output = level;
+      if (layout.isPadded()) {
+        canvas_pixels.assign(layout.canvas_w * layout.canvas_h * 4, 0);
+        output = ImageView(canvas_pixels.data(), layout.canvas_w, layout.canvas_h, 4);
+        copyToRgba(level, output.subview(0, layout.canvas_h - layout.height, layout.width, layout.canvas_h));
+      }
+
+      messages += "\n" + exportTexTargets(output, std::format("{}{}.tex", base, layout.suffix), options, policy);
+    }
+    return messages;
+  }
+
+  // Pixels as they are handed to the encoder: RGBA, with alpha already premultiplied when requested.
+  // Channel expansion and premultiplication are fused into the single pass that reads the source, and
+  // the options are adjusted so the encoder doesn't premultiply a second time.
+  struct EncoderInput {
+    // Null when `image` borrows the source
+    std::shared_ptr<std::vector<uint8_t>> pixels;
+    ImageView image;
+    ImageToTexConversionOptions options;
+
+    // Sources that won't outlive the call (e.g. JS buffers used from a worker thread) need `copy`
+    EncoderInput(const ImageView& source, const ImageToTexConversionOptions& source_options, bool copy)
+    : image(source), options(source_options) {
+      if (!copy && source.channels == 4 && !options.pre_multiply_alpha) {
+        return;
+      }
+
+      pixels = std::make_shared<std::vector<uint8_t>>(source.width * source.height * 4);
+      image = ImageView(pixels->data(), source.width, source.height, 4);
+      copyToRgba(source, image, options.pre_multiply_alpha);
+      options.pre_multiply_alpha = false;
+    }
+  };
+
   addon_value exportTex(addon_env env, addon_callback_info info) {
     try {
       auto args = UxpHelper::getArgs<4>(info);
@@ -419,133 +1124,576 @@ namespace
       const auto image_data = ImageData(args[2]);
       const auto options = ImageToTexConversionOptions(args[3]);
 
-      TexConverter::convertImageToTex(
-        Image::Image8(image_data.data, image_data.size.w, image_data.size.h, image_data.channels),
-        output_file,
-        options.pixel_format,
-        options.mipmap_filter,
-        options.texture_type,
-        options.generate_mipmaps,
-        options.pre_multiply_alpha
+      const EncoderInput input(image_data.view(), options, false);
+
+      return Value(exportTexVariants(input.image, output_file, input.options, variantLayouts(doc))).Convert(env);
+    } catch (...) {
+      return CreateErrorFromException(env);
+    }
+  }
+
+  // Runs `work` in a Task scheduled by `schedule(task, handler)` and resolves the returned promise on the
+  // scripting thread with the value produced by `resolve(env, result)`. Exceptions thrown by either side
+  // reject the promise.
+  template <class Schedule, class Work, class Resolve>
+  addon_value runTask(addon_env env, Schedule&& schedule, Work&& work, Resolve&& resolve) {
+    using Result = std::invoke_result_t<Work>;
+
+    struct State {
+      std::optional<Result> result;
+      std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+
+    auto script_thread_handler = [state, resolve](const Task&, addon_env env, addon_deferred deferred) {
+      try {
+        HandlerScope scope(env);
+        try {
+          if (state->error) {
+            std::rethrow_exception(state->error);
+          }
+          Check(UxpAddonApis.uxp_addon_resolve_deferred(env, deferred, resolve(env, std::move(*state->result))));
+        } catch (...) {
+          Check(UxpAddonApis.uxp_addon_reject_deferred(env, deferred, CreateErrorFromException(env)));
+        }
+      } catch (...) {}
+    };
+
+    auto worker_thread_handler = [state, work, script_thread_handler](Task& task) {
+      try {
+        state->result.emplace(work());
+      } catch (...) {
+        state->error = std::current_exception();
+      }
+      task.ScheduleOnScriptingThread(script_thread_handler);
+    };
+
+    const auto task = Task::Create();
+    return schedule(*task, worker_thread_handler);
+  }
+
+  // runTask through `executor`, e.g. a JobQueue
+  template <class Work, class Resolve>
+  addon_value runWith(addon_env env, const Task::Executor& executor, Work&& work, Resolve&& resolve) {
+    return runTask(env,
+      [env, &executor](Task& task, const Task::Handler& handler) { return task.ScheduleWith(env, handler, executor); },
+      std::forward<Work>(work), std::forward<Resolve>(resolve)
+    );
+  }
+
+  // runTask on a newly spawned worker thread
+  template <class Work, class Resolve>
+  addon_value runOnWorkerThread(addon_env env, Work&& work, Resolve&& resolve) {
+    return runTask(env,
+      [env](Task& task, const Task::Handler& handler) { return task.ScheduleOnWorkerThread(env, handler); },
+      std::forward<Work>(work), std::forward<Resolve>(resolve)
+    );
+  }
+
+  /*
+   * Same as exportTex but encodes and writes the texture on a worker thread.
+   * The pixels are copied before returning, so the caller may release its ImageData as soon as
+   * this returns. The promise resolves with the same message as exportTex.
+   */
+  addon_value exportTexAsync(addon_env env, addon_callback_info info) {
+    try {
+      auto args = UxpHelper::getArgs<4>(info);
+      const auto doc = Document(args[0]);
+      auto output_file = std::format("{}/{}.tex", UxpHelper::getString(args[1]), doc.name_no_ext);
+      const auto image_data = ImageData(args[2]);
+      const auto options = ImageToTexConversionOptions(args[3]);
+      EncoderInput input(image_data.view(), options, true);
+
+      return runOnWorkerThread(env,
+        [input, output_file, layouts = variantLayouts(doc)] {
+          return exportTexVariants(input.image, output_file, input.options, layouts);
+        },
+        [](addon_env env, std::string&& message) { return Value(std::move(message)).Convert(env); }
       );
+    } catch (...) {
+      return CreateErrorFromException(env);
+    }
+  }
 
-      return Value(std::format("Successfully exported {}.", output_file)).Convert(env);
+  /*
+   * Exports the texture and its atlas in one call. The document is read from JS once: its name, size,
+   * grid and layers feed both outputs. The atlas is built on the scripting thread, then the atlas write
+   * and the texture encode run concurrently on worker threads.
+   * Every written texture gets its own atlas, so `texPaths` and `atlasPaths` pair up: one per layout and
+   * target, the 1x layout first.
+   *   exportTexAndAtlas(doc, outputFolder, imageData, options)
+   *     -> Promise<{texPaths, atlasPaths, message, timings: {parseMs, atlasMs, encodeMs, totalMs}}>
+   */
+  addon_value exportTexAndAtlas(addon_env env, addon_callback_info info) {
+    try {
+      using Clock = std::chrono::steady_clock;
+      auto to_ms = [](Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+      const auto started_at = Clock::now();
+
+      auto args = UxpHelper::getArgs<4>(info);
+      const auto doc = Document(args[0]);
+      const auto output_folder = UxpHelper::getString(args[1]);
+      auto tex_path = std::format("{}/{}.tex", output_folder, doc.name_no_ext);
+      const auto image_data = ImageData(args[2]);
+      const auto options = ImageToTexConversionOptions(args[3]);
+      EncoderInput input(image_data.view(), options, true);
+      auto layouts = std::make_shared<std::vector<VariantLayout>>(variantLayouts(doc));
+      auto atlases = std::make_shared<std::vector<Atlas>>(buildAtlases(doc, *layouts));
+      const auto parse_ms = to_ms(Clock::now() - started_at);
+
+
+      return runOnWorkerThread(env,
+        [input, output_folder, name = std::string(doc.name_no_ext), tex_path, layouts, atlases, parse_ms, started_at, to_ms] {
+          auto atlas_write = std::async(std::launch::async, [&output_folder, &name, atlases, to_ms] {
+            const auto atlas_started_at = Clock::now();
+            auto message = writeAtlases(output_folder, name, *atlases);
+            return std::make_pair(std::move(message), to_ms(Clock::now() - atlas_started_at));
+          });
+
+          const auto encode_started_at = Clock::now();
+          auto tex_message = exportTexVariants(input.image, tex_path, input.options, *layouts);
+          const auto encode_ms = to_ms(Clock::now() - encode_started_at);
+          const auto [atlas_message, atlas_ms] = atlas_write.get();
+
+          Value timings(Value::Kind::map);
+          timings.GetMap().emplace("parseMs", Value(parse_ms));
+          timings.GetMap().emplace("atlasMs", Value(atlas_ms));
+          timings.GetMap().emplace("encodeMs", Value(encode_ms));
+          timings.GetMap().emplace("totalMs", Value(to_ms(Clock::now() - started_at)));
+
+          Value result(Value::Kind::map);
+          Value tex_paths(Value::Kind::list), atlas_paths(Value::Kind::list);
+          for (const auto& atlas : *atlases) {
+            tex_paths.GetList().emplace_back(std::format("{}/{}{}.tex", output_folder, name, atlas.suffix));
+            atlas_paths.GetList().emplace_back(std::format("{}/{}{}.xml", output_folder, name, atlas.suffix));
+          }
+          result.GetMap().emplace("texPaths", std::move(tex_paths));
+          result.GetMap().emplace("atlasPaths", std::move(atlas_paths));
+          result.GetMap().emplace("message", Value(std::format("{}\n{}", tex_message, atlas_message)));
+          result.GetMap().emplace("timings", std::move(timings));
+          return result;
+        },
+        [](addon_env env, Value&& result) { return result.Convert(env); }
+      );
     } catch (...) {
       return CreateErrorFromException(env);
     }
   }
 
-  addon_value importTex(addon_env env, addon_callback_info info) {
+  /*
+   * Encodes the texture on a worker thread and resolves with the bytes of the .tex file as an
+   * ArrayBuffer instead of writing it, e.g. to hash, upload or compare it.
+   *   exportTexToBuffer(imageData, options) -> Promise<ArrayBuffer>
+   */
+  addon_value exportTexToBuffer(addon_env env, addon_callback_info info) {
     try {
       auto args = UxpHelper::getArgs<2>(info);
+      const auto image_data = ImageData(args[0]);
+      const auto options = ImageToTexConversionOptions(args[1]);
+      EncoderInput input(image_data.view(), options, true);
+
+      return runOnWorkerThread(env,
+        [input] {
+          auto options = input.options;
+          choosePixelFormat(input.image, options);
+          return encodeTex(input.image, options);
+        },
+        [](addon_env, std::vector<uint8_t>&& bytes) {
+          auto encoded = std::make_unique<std::vector<uint8_t>>(std::move(bytes));
+          auto* data = encoded->data();
+          const auto length = encoded->size();
+          return UxpHelper::ArrayBuffer<uint8_t>(std::move(encoded), data, length).uxpValue();
+        }
+      );
+    } catch (...) {
+      return CreateErrorFromException(env);
+    }
+  }
 
-      const auto tex_file_path = UxpHelper::getString(args[0]);
-      std::optional<std::string> atlas_file_path;
+  /*
+   * Hit/miss counters of the shared texture store since the addon was loaded, plus its current size.
+   *   textureStoreStats(folder?) -> {hits, misses, entries, bytes}
+   */
+  addon_value textureStoreStats(addon_env env, addon_callback_info info) {
+    try {
+      auto args = UxpHelper::getArgs<1>(info);
+      std::filesystem::path folder = TextureStore::defaultFolder();
       try {
-        atlas_file_path = UxpHelper::convert<std::string>(args[1]);
+        folder = UxpHelper::convert<std::string>(args[0]);
       } catch (std::exception&) {}
 
-      const auto doc_name = std::filesystem::path(tex_file_path).filename().replace_extension(".psd").string();
-      auto image = TexConverter::convertTexToImage(tex_file_path);
+      const auto stats = TextureStore(folder, 0).stats();
 
       addon_value obj;
       Check(UxpAddonApis.uxp_addon_create_object(env, &obj));
-      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "name", Value(doc_name).Convert(env)));
-      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "w", Value(double(image.width())).Convert(env)));
-      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "h", Value(double(image.height())).Convert(env)));
+      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "hits", Value(double(stats.hits)).Convert(env)));
+      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "misses", Value(double(stats.misses)).Convert(env)));
+      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "entries", Value(double(stats.entries)).Convert(env)));
+      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "bytes", Value(double(stats.bytes)).Convert(env)));
 
-      pugi::xml_document atlas;
-      if (!atlas_file_path.has_value() || !atlas.load_file(atlas_file_path->c_str())) {
-        size_t data_len = image.height() * image.width() * image.channels();
-        addon_value array_buffer;
-        Check(UxpAddonApis.uxp_addon_create_arraybuffer(env, data_len, nullptr, &array_buffer));
-        addon_value uint8_array;
-        Check(UxpAddonApis.uxp_addon_create_typedarray(env, addon_uint8_array,
-            data_len,
-            array_buffer,
-            0,
-            &uint8_array
-          )
-        );
-        for (int i = 0; i < data_len; ++i) {
-          addon_value chval = nullptr;
-          Check(UxpAddonApis.uxp_addon_create_uint32(env, image.data()[i], &chval));
-          Check(UxpAddonApis.uxp_addon_set_element(env, uint8_array, i, chval));
+      return obj;
+    } catch (...) {
+      return CreateErrorFromException(env);
+    }
+  }
+
+  /*
+   * Tiled export. Instead of handing the whole document over in one buffer, JS fetches it in tiles
+   * that are copied into a single native image as they arrive, so only one tile is alive on the JS
+   * side at any time.
+   * Tiles are expanded to RGBA and premultiplied while they are copied in.
+   *   beginTexStream(doc, outputFolder, {size}, options) -> handle
+   *   writeTexTile(handle, left, top, imageData)
+   *   finishTexStream(handle) -> Promise<string>, encodes on a worker thread like exportTexAsync
+   */
+  struct TexStream {
+    std::string output_file;
+    ImageToTexConversionOptions options;
+    std::vector<VariantLayout> layouts;
+    bool pre_multiply_alpha;
+    std::vector<uint8_t> pixels;
+    ImageView image;
+    // One bit per pixel, so overlapping tiles are rejected and finishing can't leave holes
+    std::vector<bool> covered;
+    size_t pixels_written = 0;
+    bool finished = false;
+
+    TexStream(std::string output_file, const ImageToTexConversionOptions& source_options,
+              std::vector<VariantLayout> layouts, size_t w, size_t h)
+    : output_file(std::move(output_file)),
+      options(source_options),
+      layouts(std::move(layouts)),
+      pre_multiply_alpha(source_options.pre_multiply_alpha),
+      pixels(w * h * 4),
+      image(pixels.data(), w, h, 4),
+      covered(w * h, false) {
+      options.pre_multiply_alpha = false;
+    }
+
+    void write(size_t left, size_t top, const ImageView& tile) {
+      if (finished) {
+        throw std::runtime_error("Tex stream was already finished");
+      }
+
+      const auto target = image.subview(left, top, left + tile.width, top + tile.height);
+      for (size_t y = top; y < top + tile.height; y++) {
+        const auto row = covered.begin() + static_cast<std::ptrdiff_t>(y * image.width);
+        if (std::find(row + static_cast<std::ptrdiff_t>(left), row + static_cast<std::ptrdiff_t>(left + tile.width), true) !=
+            row + static_cast<std::ptrdiff_t>(left + tile.width)) {
+          throw std::runtime_error(std::format("Tile at {}, {} overlaps a tile that was already written", left, top));
         }
-        Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "buffer", uint8_array));
+      }
 
-        return obj;
+      copyToRgba(tile, target, pre_multiply_alpha);
+      for (size_t y = top; y < top + tile.height; y++) {
+        const auto row = covered.begin() + static_cast<std::ptrdiff_t>(y * image.width);
+        std::fill(row + static_cast<std::ptrdiff_t>(left), row + static_cast<std::ptrdiff_t>(left + tile.width), true);
       }
+      pixels_written += tile.width * tile.height;
+    }
+  };
 
-      addon_value buffers;
-      Check(UxpAddonApis.uxp_addon_create_array(env, &buffers));
-      size_t i = 0;
-      for (pugi::xml_node element : atlas.child("Atlas").child("Elements").children("Element")) {
-        auto name = std::string{element.attribute("name").as_string()};
-        double u1 = element.attribute("u1").as_double(), u2 = element.attribute("u2").as_double();
-        double v1 = element.attribute("v1").as_double(), v2 = element.attribute("v2").as_double();
-        auto left = static_cast<size_t>(u1 * image.width()), right = static_cast<size_t>(u2 * image.width());
-        auto bottom = image.height() - static_cast<size_t>(v1 * image.height());
-        auto top = image.height() - static_cast<size_t>(v2 * image.height());
-        auto width = right - left, height = bottom - top;
-        auto stride = width * image.channels();
-        auto data_len = height * stride;
-
-        addon_value array_buffer;
-        Check(UxpAddonApis.uxp_addon_create_arraybuffer(env, data_len, nullptr, &array_buffer));
-        addon_value uint8_array;
-        Check(UxpAddonApis.uxp_addon_create_typedarray(env, addon_uint8_array,
-            data_len,
-            array_buffer,
-            0,
-            &uint8_array
-          )
-        );
+  addon_value beginTexStream(addon_env env, addon_callback_info info) {
+    try {
+      auto args = UxpHelper::getArgs<4>(info);
+      const auto doc = Document(args[0]);
+      auto output_file = std::format("{}/{}.tex", UxpHelper::getString(args[1]), doc.name_no_ext);
+      const auto size = UxpHelper::getProperty<Size>(args[2], "size");
+      const auto options = ImageToTexConversionOptions(args[3]);
+
+      auto stream = std::make_shared<TexStream>(std::move(output_file), options, variantLayouts(doc),
+        static_cast<size_t>(size.w), static_cast<size_t>(size.h));
 
-        size_t bufidx = 0;
-        for (size_t y = top; y < bottom; y++) {
-          for (size_t x = left; x < right; x++) {
-            auto px = image.pixelAt(static_cast<int>(x), static_cast<int>(y));
+      return UxpHelper::External<TexStream>(std::move(stream)).uxpValue();
+    } catch (...) {
+      return CreateErrorFromException(env);
+    }
+  }
 
-            addon_value chval = nullptr;
-            Check(UxpAddonApis.uxp_addon_create_uint32(env, px.r, &chval));
-            Check(UxpAddonApis.uxp_addon_set_element(env, uint8_array, bufidx++, chval));
+  addon_value writeTexTile(addon_env env, addon_callback_info info) {
+    try {
+      auto args = UxpHelper::getArgs<4>(info);
+      const auto stream = UxpHelper::External<TexStream>(args[0]).object;
+      const auto left = UxpHelper::convert<size_t>(args[1]);
+      const auto top = UxpHelper::convert<size_t>(args[2]);
+      const auto tile = ImageData(args[3]);
 
-            Check(UxpAddonApis.uxp_addon_create_uint32(env, px.g, &chval));
-            Check(UxpAddonApis.uxp_addon_set_element(env, uint8_array, bufidx++, chval));
+      stream->write(left, top, tile.view());
 
-            Check(UxpAddonApis.uxp_addon_create_uint32(env, px.b, &chval));
-            Check(UxpAddonApis.uxp_addon_set_element(env, uint8_array, bufidx++, chval));
+      return nullptr;
+    } catch (...) {
+      return CreateErrorFromException(env);
+    }
+  }
 
-            Check(UxpAddonApis.uxp_addon_create_uint32(env, px.a, &chval));
-            Check(UxpAddonApis.uxp_addon_set_element(env, uint8_array, bufidx++, chval));
-          }
+  addon_value finishTexStream(addon_env env, addon_callback_info info) {
+    try {
+      auto args = UxpHelper::getArgs<1>(info);
+      auto stream = UxpHelper::External<TexStream>(args[0]).object;
+      if (stream->finished) {
+        throw std::runtime_error("Tex stream was already finished");
+      }
+      if (stream->pixels_written < stream->image.width * stream->image.height) {
+        throw std::runtime_error(std::format("Tex stream is missing {} pixels",
+          stream->image.width * stream->image.height - stream->pixels_written));
+      }
+      stream->finished = true;
+
+      return runOnWorkerThread(env,
+        [stream] {
+          auto message = exportTexVariants(stream->image, stream->output_file, stream->options, stream->layouts);
+          // The handle may outlive the export on the JS side, the pixels don't have to
+          stream->pixels = {};
+          stream->covered = {};
+          return message;
+        },
+        [](addon_env env, std::string&& message) { return Value(std::move(message)).Convert(env); }
+      );
+    } catch (...) {
+      return CreateErrorFromException(env);
+    }
+  }
+
+  /*
+   * Batch export. JS creates a queue sized to the encode budget, then for each document fetches its
+   * pixels and enqueues them. Pixels are copied on enqueue, so JS can dispose them and fetch the next
+   * document while earlier ones are still encoding.
+   *   createExportQueue(concurrency) -> {queue, concurrency}, 0 uses one thread per core
+   *   enqueueTexExport(queue, doc, outputFolder, imageData, options)
+   *     -> Promise<{name, message, queuedMs, encodeMs}>, resolved once that document is written
+   */
+  addon_value createExportQueue(addon_env env, addon_callback_info info) {
+    try {
+      auto args = UxpHelper::getArgs<1>(info);
+      auto queue = std::make_shared<JobQueue>(UxpHelper::getOptionalProperty<size_t>(args[0], "concurrency", 0));
+      const auto concurrency = queue->concurrency();
+
+      addon_value obj;
+      Check(UxpAddonApis.uxp_addon_create_object(env, &obj));
+      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "queue",
+          UxpHelper::External<JobQueue>(std::move(queue)).uxpValue()
+        )
+      );
+      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "concurrency", Value(double(concurrency)).Convert(env)));
+
+      return obj;
+    } catch (...) {
+      return CreateErrorFromException(env);
+    }
+  }
+
+  addon_value enqueueTexExport(addon_env env, addon_callback_info info) {
+    try {
+      auto args = UxpHelper::getArgs<5>(info);
+      auto queue = UxpHelper::External<JobQueue>(args[0]).object;
+      const auto doc = Document(args[1]);
+      auto output_file = std::format("{}/{}.tex", UxpHelper::getString(args[2]), doc.name_no_ext);
+      const auto image_data = ImageData(args[3]);
+      const auto options = ImageToTexConversionOptions(args[4]);
+      EncoderInput input(image_data.view(), options, true);
+
+      using Clock = std::chrono::steady_clock;
+      auto queued_at = Clock::now();
+      auto to_ms = [](Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+
+      return runWith(env,
+        [queue](std::function<void()> run) { queue->push(std::move(run)); },
+        [input, output_file, queued_at, to_ms, name = doc.name, layouts = variantLayouts(doc)] {
+          auto started_at = Clock::now();
+          auto message = exportTexVariants(input.image, output_file, input.options, layouts, std::launch::deferred);
+          auto finished_at = Clock::now();
+
+          Value result(Value::Kind::map);
+          result.GetMap().emplace("name", Value(name));
+          result.GetMap().emplace("message", Value(std::move(message)));
+          result.GetMap().emplace("queuedMs", Value(to_ms(started_at - queued_at)));
+          result.GetMap().emplace("encodeMs", Value(to_ms(finished_at - started_at)));
+          return result;
+        },
+        [](addon_env env, Value&& result) { return result.Convert(env); }
+      );
+    } catch (...) {
+      return CreateErrorFromException(env);
+    }
+  }
+
+  struct ImportedTex {
+    struct Element {
+      std::string name;
+      size_t left, top, right, bottom;
+      std::unique_ptr<std::vector<uint8_t>> pixels;
+    };
+
+    std::string name;
+    size_t w = 0, h = 0;
+    // Set when no atlas was given, otherwise the image is split into `elements`
+    std::unique_ptr<Image::Image8> image;
+    std::vector<Element> elements;
+
+    struct AtlasElement {
+      std::string name;
+      double u1, u2, v1, v2;
+    };
+
+    // Reads either a binary `.atlas` sidecar, used in place, or an XML atlas. False if neither could be read.
+    static bool readAtlas(const std::string& atlas_file_path, std::vector<AtlasElement>& elements) {
+      std::ifstream file(atlas_file_path, std::ios::binary | std::ios::ate);
+      if (!file) {
+        return false;
+      }
+      std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+      file.seekg(0);
+      if (!file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+        return false;
+      }
+
+      if (AtlasBinary::View::isAtlas(bytes)) {
+        const AtlasBinary::View atlas(bytes);
+        elements.reserve(atlas.size());
+        for (size_t i = 0; i < atlas.size(); i++) {
+          const auto& uv = atlas.uv(i);
+          elements.push_back({std::string(atlas.name(i)), uv.u1, uv.u2, uv.v1, uv.v2});
         }
+        return true;
+      }
 
-        addon_value obj;
-        Check(UxpAddonApis.uxp_addon_create_object(env, &obj));
-        Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "name",
-            Value(name.substr(0, name.size() - 4)).Convert(env)
-          )
-        );
-        Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "buffer", uint8_array));
-        Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "w", Value(double(width)).Convert(env)));
-        Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "h", Value(double(height)).Convert(env)));
-        Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "left", Value(double(left)).Convert(env)));
-        Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "right", Value(double(right)).Convert(env)));
-        Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "bottom", Value(double(bottom)).Convert(env)));
-        Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "top", Value(double(top)).Convert(env)));
+      pugi::xml_document atlas;
+      if (!atlas.load_buffer_inplace(bytes.data(), bytes.size())) {
+        return false;
+      }
+      for (pugi::xml_node element : atlas.child("Atlas").child("Elements").children("Element")) {
+        elements.push_back({
+          element.attribute("name").as_string(),
+          element.attribute("u1").as_double(), element.attribute("u2").as_double(),
+          element.attribute("v1").as_double(), element.attribute("v2").as_double()
+        });
+      }
+      return true;
+    }
+
+    // Reads, decodes and crops the texture. Doesn't touch any JS value so it can run on any thread.
+    static ImportedTex decode(const std::string& tex_file_path, const std::optional<std::string>& atlas_file_path) {
+      ImportedTex result;
+      result.name = std::filesystem::path(tex_file_path).filename().replace_extension(".psd").string();
 
-        Check(UxpAddonApis.uxp_addon_set_element(env, buffers, i++, obj));
+      auto image = TexConverter::convertTexToImage(tex_file_path);
+      result.w = static_cast<size_t>(image.width());
+      result.h = static_cast<size_t>(image.height());
+
+      std::vector<AtlasElement> atlas;
+      if (!atlas_file_path.has_value() || !readAtlas(*atlas_file_path, atlas)) {
+        result.image = std::make_unique<Image::Image8>(std::move(image));
+        return result;
+      }
+
+      const auto image_w = result.w, image_h = result.h;
+      const ImageView image_view(image.data(), image_w, image_h, static_cast<size_t>(image.channels()));
+      for (const auto& [name, u1, u2, v1, v2] : atlas) {
+        // Malformed u/v values are clamped to the texture so the crop never reads outside of it.
+        // NaN (e.g. a garbage attribute) compares false against both bounds, so it is mapped to 0 first.
+        // Edges are rounded, not truncated, as float UVs from a binary atlas can land just below the pixel.
+        auto to_pixel = [](double uv, size_t extent) {
+          return static_cast<size_t>(std::lround(std::clamp(std::isnan(uv) ? 0.0 : uv, 0.0, 1.0) * static_cast<double>(extent)));
+        };
+        auto left = to_pixel(u1, image_w), right = std::max(left, to_pixel(u2, image_w));
+        auto bottom = image_h - to_pixel(v1, image_h);
+        auto top = std::min(bottom, image_h - to_pixel(v2, image_h));
+
+        auto pixels = std::make_unique<std::vector<uint8_t>>((right - left) * (bottom - top) * 4);
+        copyToRgba(image_view.subview(left, top, right, bottom), ImageView(pixels->data(), right - left, bottom - top, 4));
+
+        result.elements.push_back({name.substr(0, name.size() - 4), left, top, right, bottom, std::move(pixels)});
+      }
+
+      return result;
+    }
+
+    // Builds the JS result, handing every pixel buffer over to JS without copying it.
+    // Must be called on the scripting thread.
+    addon_value toUxpValue(addon_env env) {
+      addon_value obj;
+      Check(UxpAddonApis.uxp_addon_create_object(env, &obj));
+      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "name", Value(name).Convert(env)));
+      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "w", Value(double(w)).Convert(env)));
+      Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "h", Value(double(h)).Convert(env)));
+
+      if (image) {
+        size_t data_len = h * w * image->channels();
+        auto* pixels = image->data();
+        UxpHelper::ArrayBuffer<uint8_t> buffer(std::move(image), pixels, data_len);
+        Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "buffer", buffer.toUint8Array()));
+
+        return obj;
+      }
+
+      addon_value buffers;
+      Check(UxpAddonApis.uxp_addon_create_array(env, &buffers));
+      size_t i = 0;
+      for (auto& element : elements) {
+        auto width = element.right - element.left, height = element.bottom - element.top;
+        auto* pixels = element.pixels->data();
+        auto data_len = element.pixels->size();
+        UxpHelper::ArrayBuffer<uint8_t> buffer(std::move(element.pixels), pixels, data_len);
+
+        addon_value element_obj;
+        Check(UxpAddonApis.uxp_addon_create_object(env, &element_obj));
+        Check(UxpAddonApis.uxp_addon_set_named_property(env, element_obj, "name", Value(element.name).Convert(env)));
+        Check(UxpAddonApis.uxp_addon_set_named_property(env, element_obj, "buffer", buffer.toUint8Array()));
+        Check(UxpAddonApis.uxp_addon_set_named_property(env, element_obj, "w", Value(double(width)).Convert(env)));
+        Check(UxpAddonApis.uxp_addon_set_named_property(env, element_obj, "h", Value(double(height)).Convert(env)));
+        Check(UxpAddonApis.uxp_addon_set_named_property(env, element_obj, "left", Value(double(element.left)).Convert(env)));
+        Check(UxpAddonApis.uxp_addon_set_named_property(env, element_obj, "right", Value(double(element.right)).Convert(env)));
+        Check(UxpAddonApis.uxp_addon_set_named_property(env, element_obj, "bottom", Value(double(element.bottom)).Convert(env)));
+        Check(UxpAddonApis.uxp_addon_set_named_property(env, element_obj, "top", Value(double(element.top)).Convert(env)));
+
+        Check(UxpAddonApis.uxp_addon_set_element(env, buffers, i++, element_obj));
       }
 
       Check(UxpAddonApis.uxp_addon_set_named_property(env, obj, "buffers", buffers));
 
       return obj;
+    }
+  };
+
+  std::pair<std::string, std::optional<std::string>> getImportTexArgs(addon_callback_info info) {
+    auto args = UxpHelper::getArgs<2>(info);
+
+    auto tex_file_path = UxpHelper::getString(args[0]);
+    std::optional<std::string> atlas_file_path;
+    try {
+      atlas_file_path = UxpHelper::convert<std::string>(args[1]);
+    } catch (std::exception&) {}
+
+    return {std::move(tex_file_path), std::move(atlas_file_path)};
+  }
+
+  addon_value importTex(addon_env env, addon_callback_info info) {
+    try {
+      const auto [tex_file_path, atlas_file_path] = getImportTexArgs(info);
+
+      return ImportedTex::decode(tex_file_path, atlas_file_path).toUxpValue(env);
+    } catch (...) {
+      return CreateErrorFromException(env);
+    }
+  }
+
+  /*
+   * Same as importTex but reads, decodes and crops the texture on a worker thread.
+   * Returns a promise that is resolved on the scripting thread with the importTex result.
+   */
+  addon_value importTexAsync(addon_env env, addon_callback_info info) {
+    try {
+      auto paths = getImportTexArgs(info);
+
+      return runOnWorkerThread(env,
+        [paths] { return ImportedTex::decode(paths.first, paths.second); },
+        [](addon_env env, ImportedTex&& imported) { return imported.toUxpValue(env); }
+      );
     } catch (...) {
       return CreateErrorFromException(env);
     }
   }
+
   /*
    * This function will echo the provided argument after converting to and from a
    * standard value type.
@@ -636,6 +1784,136 @@ namespace
     }
 
 
+    // exportTexAsync
+    {
+      status = addon_apis.uxp_addon_create_function(env, nullptr, 0, exportTexAsync, nullptr, &fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to wrap native function");
+      }
+
+      status = addon_apis.uxp_addon_set_named_property(env, exports, "exportTexAsync", fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to populate exports");
+      }
+    }
+
+    // exportTexAndAtlas
+    {
+      status = addon_apis.uxp_addon_create_function(env, nullptr, 0, exportTexAndAtlas, nullptr, &fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to wrap native function");
+      }
+
+      status = addon_apis.uxp_addon_set_named_property(env, exports, "exportTexAndAtlas", fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to populate exports");
+      }
+    }
+
+    // exportTexToBuffer
+    {
+      status = addon_apis.uxp_addon_create_function(env, nullptr, 0, exportTexToBuffer, nullptr, &fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to wrap native function");
+      }
+
+      status = addon_apis.uxp_addon_set_named_property(env, exports, "exportTexToBuffer", fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to populate exports");
+      }
+    }
+
+    // packAtlas
+    {
+      status = addon_apis.uxp_addon_create_function(env, nullptr, 0, packAtlas, nullptr, &fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to wrap native function");
+      }
+
+      status = addon_apis.uxp_addon_set_named_property(env, exports, "packAtlas", fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to populate exports");
+      }
+    }
+
+    // textureStoreStats
+    {
+      status = addon_apis.uxp_addon_create_function(env, nullptr, 0, textureStoreStats, nullptr, &fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to wrap native function");
+      }
+
+      status = addon_apis.uxp_addon_set_named_property(env, exports, "textureStoreStats", fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to populate exports");
+      }
+    }
+
+    // beginTexStream
+    {
+      status = addon_apis.uxp_addon_create_function(env, nullptr, 0, beginTexStream, nullptr, &fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to wrap native function");
+      }
+
+      status = addon_apis.uxp_addon_set_named_property(env, exports, "beginTexStream", fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to populate exports");
+      }
+    }
+
+    // writeTexTile
+    {
+      status = addon_apis.uxp_addon_create_function(env, nullptr, 0, writeTexTile, nullptr, &fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to wrap native function");
+      }
+
+      status = addon_apis.uxp_addon_set_named_property(env, exports, "writeTexTile", fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to populate exports");
+      }
+    }
+
+    // finishTexStream
+    {
+      status = addon_apis.uxp_addon_create_function(env, nullptr, 0, finishTexStream, nullptr, &fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to wrap native function");
+      }
+
+      status = addon_apis.uxp_addon_set_named_property(env, exports, "finishTexStream", fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to populate exports");
+      }
+    }
+
+    // createExportQueue
+    {
+      status = addon_apis.uxp_addon_create_function(env, nullptr, 0, createExportQueue, nullptr, &fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to wrap native function");
+      }
+
+      status = addon_apis.uxp_addon_set_named_property(env, exports, "createExportQueue", fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to populate exports");
+      }
+    }
+
+    // enqueueTexExport
+    {
+      status = addon_apis.uxp_addon_create_function(env, nullptr, 0, enqueueTexExport, nullptr, &fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to wrap native function");
+      }
+
+      status = addon_apis.uxp_addon_set_named_property(env, exports, "enqueueTexExport", fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to populate exports");
+      }
+    }
+
     // exportAtlas
     {
       status = addon_apis.uxp_addon_create_function(env, nullptr, 0, exportAtlas, nullptr, &fn);
@@ -662,6 +1940,19 @@ namespace
       }
     }
 
+    // importTexAsync
+    {
+      status = addon_apis.uxp_addon_create_function(env, nullptr, 0, importTexAsync, nullptr, &fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to wrap native function");
+      }
+
+      status = addon_apis.uxp_addon_set_named_property(env, exports, "importTexAsync", fn);
+      if (status != addon_ok) {
+        addon_apis.uxp_addon_throw_error(env, nullptr, "Unable to populate exports");
+      }
+    }
+
     return exports;
   }
 } // namespace
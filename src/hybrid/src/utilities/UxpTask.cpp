@@ -10,6 +10,8 @@
 
 #include "UxpTask.h"
 
+#include <thread>
+
 #include "UxpAddon.h"
 
 struct TaskWrapper {
@@ -27,7 +29,7 @@ void TaskWrapperDestructor(addon_task_data data) {
 
 void TaskWrapper::MainThreadThunk(addon_task_data data) {
     try {
-        reinterpret_cast<TaskWrapper*>(data)->task->InvokeMainThreadHandler();
+        reinterpret_cast<TaskWrapper*>(data)->task->InvokeHandler();
     } catch (...) {
     }
 }
@@ -43,7 +45,7 @@ std::shared_ptr<Task> Task::Create() {
     return std::shared_ptr<Task>(new Task);
 }
 
-addon_value Task::ScheduleOnMainThread(addon_env env, const Handler& handler) {
+addon_value Task::CreatePromise(addon_env env, const Handler& handler) {
     if (mDeferred != nullptr)
         throw "Tasks can only be used to schedule one operation";
 
@@ -52,16 +54,39 @@ addon_value Task::ScheduleOnMainThread(addon_env env, const Handler& handler) {
     addon_value promise = nullptr;
     Check(UxpAddonApis.uxp_addon_create_promise(env, &mDeferred, &promise));
 
+    mEnv = env;
+
+    return promise;
+}
+
+addon_value Task::ScheduleOnMainThread(addon_env env, const Handler& handler) {
+    addon_value promise = CreatePromise(env, handler);
+
     TaskWrapper* wrapper = new TaskWrapper;
     wrapper->task = shared_from_this();
 
-    mEnv = env;
-
     UxpAddonApis.uxp_addon_schedule_on_main_queue(env, TaskWrapper::MainThreadThunk, wrapper, TaskWrapperDestructor);
 
     return promise;
 }
 
+addon_value Task::ScheduleOnWorkerThread(addon_env env, const Handler& handler) {
+    return ScheduleWith(env, handler, [](std::function<void()> run) { std::thread(std::move(run)).detach(); });
+}
+
+addon_value Task::ScheduleWith(addon_env env, const Handler& handler, const Executor& executor) {
+    addon_value promise = CreatePromise(env, handler);
+
+    executor([task = shared_from_this()]() {
+        try {
+            task->InvokeHandler();
+        } catch (...) {
+        }
+    });
+
+    return promise;
+}
+
 void Task::ScheduleOnScriptingThread(const ResultHandler& resultHandler) {
     mResultHandler = resultHandler;
 
@@ -72,7 +97,7 @@ void Task::ScheduleOnScriptingThread(const ResultHandler& resultHandler) {
         mEnv, TaskWrapper::ScriptingThreadThunk, wrapper, TaskWrapperDestructor);
 }
 
-void Task::InvokeMainThreadHandler() {
+void Task::InvokeHandler() {
     Handler tmpHandler;
     std::swap(tmpHandler, mHandler);
     if (tmpHandler != nullptr)
@@ -32,6 +32,15 @@ class Task : public std::enable_shared_from_this<Task> {
     using Handler = std::function<void(Task&)>;
     addon_value ScheduleOnMainThread(addon_env env, const Handler& handler);
 
+    // Runs the handler on a newly spawned native thread instead of the main queue.
+    // Use this for long running work that must not block either the UI or the scripting thread.
+    addon_value ScheduleOnWorkerThread(addon_env env, const Handler& handler);
+
+    // Runs the handler through a caller provided executor, e.g. a thread pool.
+    // The executor must invoke the function it is given exactly once, on any thread.
+    using Executor = std::function<void(std::function<void()>)>;
+    addon_value ScheduleWith(addon_env env, const Handler& handler, const Executor& executor);
+
     using ResultHandler = std::function<void(Task&, addon_env env, addon_deferred deferred)>;
     void ScheduleOnScriptingThread(const ResultHandler& resultHandler);
 
@@ -43,7 +52,8 @@ class Task : public std::enable_shared_from_this<Task> {
 
  private:
     friend struct TaskWrapper;
-    void InvokeMainThreadHandler();
+    addon_value CreatePromise(addon_env env, const Handler& handler);
+    void InvokeHandler();
     void InvokeScriptingThreadHandler();
 
     Handler mHandler;
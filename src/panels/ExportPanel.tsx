@@ -1,5 +1,5 @@
 import React from "react";
-import Hybrid, {MipmapFilter, PixelFormat, TextureType} from "../api/hybrid";
+import Hybrid, {ExportTexBatchResult, MipmapFilter, PixelFormat, TextureType} from "../api/hybrid";
 import {CheckBox, DropDown} from "../components";
 import {photoshop} from "../globals";
 import {notify} from "../api/photoshop";
@@ -61,12 +61,18 @@ export function ExportPanel() {
 
   const [generateMipmaps, setGenerateMipmaps] = React.useState(false);
   const [preMultiplyAlpha, setpreMultiplyAlpha] = React.useState(false);
+  const [tiledExport, setTiledExport] = React.useState(false);
+  const [exportAllDocuments, setExportAllDocuments] = React.useState(false);
+  const [exportScaledVariants, setExportScaledVariants] = React.useState(false);
+  const [padToPowerOfTwo, setPadToPowerOfTwo] = React.useState(false);
 
   const [exportAtlas, setExportAtlas] = React.useState(true);
+  const [packAtlas, setPackAtlas] = React.useState(false);
   const [useGrid, setUseGrid] = React.useState(false);
   const [grid, setGrid] = React.useState({w: 1, h: 1});
 
   const [finishedExporting, setFinishedExporting] = React.useState(false);
+  const [batchResults, setBatchResults] = React.useState<ExportTexBatchResult[] | null>(null);
 
   const [activeDocument, setActiveDocument] = React.useState<Document | null>(photoshop.app.activeDocument);
 
@@ -88,17 +94,28 @@ export function ExportPanel() {
     if (!outputPath) { return await notify("Please choose an output folder."); }
 
     const doc = photoshop.app.activeDocument;
+    const options = {
+      pixelFormat: PixelFormat[pixelFormat],
+      textureType: TextureType[textureType],
+      mipmapFilter: MipmapFilter[mipmapFilter],
+      generateMipmaps,
+      preMultiplyAlpha,
+      // The batch queue takes whole documents as they are, so it neither tiles nor packs
+      tiledExport: tiledExport && !exportAllDocuments,
+      scaledVariants: exportScaledVariants ? 2 : 0,
+      padToPowerOfTwo,
+      exportAtlas,
+      packAtlas: packAtlas && !exportAllDocuments ? {padding: 2, blockAlign: 4} : undefined,
+      grid: useGrid ? grid : undefined
+    };
 
     try {
-      await Hybrid.exportTex(doc, outputPath, {
-        pixelFormat: PixelFormat[pixelFormat],
-        textureType: TextureType[textureType],
-        mipmapFilter: MipmapFilter[mipmapFilter],
-        generateMipmaps,
-        preMultiplyAlpha,
-        exportAtlas,
-        grid: useGrid ? grid : undefined
-      });
+      if (exportAllDocuments) {
+        setBatchResults(await Hybrid.exportTexBatch([...photoshop.app.documents], outputPath, options));
+      } else {
+        setBatchResults(null);
+        await Hybrid.exportTex(doc, outputPath, options);
+      }
 
       setFinishedExporting(true);
     } catch (err) {
@@ -128,11 +145,18 @@ export function ExportPanel() {
 
         <CheckBox label="Generate Mipmaps" checked={generateMipmaps} onClick={setGenerateMipmaps}/>
         <CheckBox label="Pre-Multiply Alpha" checked={preMultiplyAlpha} onClick={setpreMultiplyAlpha}/>
+        <CheckBox label="Fetch Pixels in Tiles" checked={tiledExport} onClick={setTiledExport} disabled={exportAllDocuments}/>
+        <CheckBox label="Export All Open Documents" checked={exportAllDocuments} onClick={setExportAllDocuments}/>
+        <div className="group-horizontal">
+          <CheckBox label="Export @0.5x and @0.25x" checked={exportScaledVariants} onClick={setExportScaledVariants}/>
+          <CheckBox label="Pad to Power of Two" checked={padToPowerOfTwo} onClick={setPadToPowerOfTwo}/>
+        </div>
 
         <div className="group-horizontal">
           <CheckBox label="Export Atlas" checked={exportAtlas} onClick={setExportAtlas}/>
           <Grid onChange={setGrid} onCheckGrid={setUseGrid}/>
         </div>
+        <CheckBox label="Pack Layers Automatically" checked={packAtlas} onClick={setPackAtlas} disabled={exportAllDocuments}/>
 
         <div className="group-horizontal" style={{justifyContent: "center", marginTop: 16, paddingRight: 8}}>
           <button disabled={!activeDocument} onClick={onExport}>
@@ -156,8 +180,15 @@ export function ExportPanel() {
           >
               <div className="group-vertical" style={{justifyContent: "center", alignItems: "start"}}>
                   <p style={{fontSize: "20px"}}>Finished Exporting Files:</p>
+                {batchResults ? batchResults.map(({name, message, error, atlasError, encodeMs}) =>
+                  <p key={name} style={error || atlasError ? {color: "#f66"} : undefined}>
+                    {error ? `${name}: ${error}` : `${message} (${Math.round(encodeMs ?? 0)} ms)`}
+                    {atlasError ? `\n${name} atlas: ${atlasError}` : ""}
+                  </p>
+                ) : <>
                   <p style={{textDecoration: "underline"}}>{truncatePath(texFullPath, 55)}</p>
                   <p style={{textDecoration: "underline"}}>{truncatePath(atlasFullPath, 55)}</p>
+                </>}
               </div>
               <button onClick={() => setFinishedExporting(false)}>Ok</button>
           </div>
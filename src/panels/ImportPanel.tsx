@@ -52,7 +52,7 @@ export function ImportPanel() {
                   label={"Atlas File:"}
                   path={atlasPath}
                   type={"file"}
-                  fileTypes={["xml"]}
+                  fileTypes={["xml", "atlas"]}
                   placeholder={"No atlas file selected."}
                   onBrowse={onBrowseAtlasFile}
                   onClear={() => setAtlasPath(undefined)}